@@ -0,0 +1,1137 @@
+/*
+sif - command-line batch converter for the Simple Image Format
+
+Copyright (c) 2022 Marcio Pais
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Encodes PPM and QOI images to SIF, decodes SIF images to PPM or QOI, and verifies SIF images,
+for single files or whole directory trees (POSIX only).
+
+  cc -O2 -o sif sif.c -lpthread
+
+Files flow through three stages connected by bounded queues: a reader loading whole files, a
+pool of worker threads running the codec, and a writer storing the results. On Linux the reader
+and writer each keep several requests in flight through io_uring; where io_uring is unavailable
+(or with --no-io-uring) each of them is a small pool of threads doing blocking I/O instead.
+Define SIF_CLI_NO_IO_URING to build without io_uring support.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#define SIF_IMPLEMENTATION
+#include "sif.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> /* strcasecmp */
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(SIF_CLI_NO_IO_URING) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#      define SIF_CLI_IO_URING
+#    endif
+#  endif
+#endif
+
+#define SIF_CLI_DEFAULT_FLAGS 0x6Bu /* 127-line tiles, decorrelate from green, contextual dictionary, green delta bias */
+#define SIF_CLI_IO_THREADS 4u /* per blocking I/O stage */
+#define SIF_CLI_RING_DEPTH 16u /* requests in flight per io_uring stage */
+#define SIF_CLI_AUTO_STRIPS 4u
+#define SIF_CLI_AUTO_STRIP_HEIGHT 64u
+#define SIF_CLI_AUTO_QOI_LINES 1024u /* QOI only decodes sequentially, so its sample spans this many top lines */
+
+typedef enum {
+  mode_encode,
+  mode_decode,
+  mode_verify
+} cli_mode;
+
+typedef struct {
+  cli_mode mode;
+  size_t threads;
+  size_t queue_capacity;
+  uint8_t flags;
+  bool auto_flags;
+  uint32_t options;
+  bool to_qoi;
+  bool use_io_uring;
+} cli_config_t;
+
+typedef struct {
+  char* input_path;
+  char* output_path; /* NULL when verifying */
+  uint8_t* data; /* the input while reading and processing, then the output */
+  size_t size;
+  size_t done; /* bytes transferred so far */
+  int fd;
+  uint64_t input_size;
+  uint64_t pixels;
+  const char* error; /* NULL on success */
+  int error_number; /* errno behind the error, if any */
+#ifdef SIF_CLI_IO_URING
+  struct iovec iov;
+#endif
+} cli_job_t;
+
+typedef struct {
+  cli_job_t** items;
+  size_t capacity, head, count;
+  bool closed;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty, not_full;
+} cli_queue_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  uint64_t files, failures, bytes_read, bytes_written, pixels;
+  double codec_seconds;
+} cli_stats_t;
+
+typedef struct {
+  const cli_config_t* config;
+  cli_job_t* jobs;
+  size_t job_count;
+  size_t next_job; /* for the blocking readers */
+  size_t active_readers, active_workers;
+  cli_queue_t loaded, processed;
+  cli_stats_t stats;
+  pthread_mutex_t lock;
+  pthread_cond_t released;
+  bool running, stopped; /* set once all threads are created, or if one could not be */
+} cli_pipeline_t;
+
+double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+void failJob(cli_job_t* const job, const char* const error, int const error_number) {
+  if (job->error == NULL) {
+    job->error = error;
+    job->error_number = error_number;
+  }
+}
+
+/* ---------------------------------------------------------------- queue */
+
+void queueInit(cli_queue_t* const queue, size_t const capacity) {
+  queue->items = (cli_job_t**)malloc(capacity * sizeof(cli_job_t*));
+  if (queue->items == NULL) {
+    fprintf(stderr, "sif: out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  queue->capacity = capacity;
+  queue->head = queue->count = 0u;
+  queue->closed = false;
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->not_empty, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+}
+
+void queueFree(cli_queue_t* const queue) {
+  free(queue->items);
+  pthread_mutex_destroy(&queue->lock);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_cond_destroy(&queue->not_full);
+}
+
+/* Blocks while the queue is full, which is what bounds the memory held by loaded files. */
+void queuePush(cli_queue_t* const queue, cli_job_t* const job) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == queue->capacity)
+    pthread_cond_wait(&queue->not_full, &queue->lock);
+  queue->items[(queue->head + queue->count++) % queue->capacity] = job;
+  pthread_cond_signal(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/* Returns NULL once the queue is closed and drained, or right away if it is empty and wait is not set. */
+cli_job_t* queuePop(cli_queue_t* const queue, bool const wait) {
+  pthread_mutex_lock(&queue->lock);
+  while ((queue->count == 0u) && !queue->closed && wait)
+    pthread_cond_wait(&queue->not_empty, &queue->lock);
+  cli_job_t* job = NULL;
+  if (queue->count > 0u) {
+    job = queue->items[queue->head];
+    queue->head = (queue->head + 1u) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return job;
+}
+
+void queueClose(cli_queue_t* const queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->closed = true;
+  pthread_cond_broadcast(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/* ---------------------------------------------------------------- file access */
+
+/* Opens the input and allocates a buffer for all of it; the read itself is left to the caller. */
+bool openInput(cli_job_t* const job) {
+  job->fd = open(job->input_path, O_RDONLY);
+  if (job->fd < 0) {
+    failJob(job, "cannot open", errno);
+    return false;
+  }
+  struct stat info;
+  if (fstat(job->fd, &info) != 0) {
+    failJob(job, "cannot stat", errno);
+    return false;
+  }
+  if ((uint64_t)info.st_size > SIZE_MAX) {
+    failJob(job, "file too large", 0);
+    return false;
+  }
+  job->size = (size_t)info.st_size;
+  job->input_size = job->size;
+  job->done = 0u;
+  job->data = (uint8_t*)SIF_MALLOC((job->size > 0u) ? job->size : 1u);
+  if (job->data == NULL) {
+    failJob(job, "out of memory", 0);
+    return false;
+  }
+  return true;
+}
+
+bool openOutput(cli_job_t* const job) {
+  job->fd = open(job->output_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (job->fd < 0) {
+    failJob(job, "cannot create", errno);
+    return false;
+  }
+  job->done = 0u;
+  return true;
+}
+
+void closeFile(cli_job_t* const job) {
+  if (job->fd >= 0)
+    close(job->fd);
+  job->fd = -1;
+}
+
+/* ---------------------------------------------------------------- io_uring */
+
+#ifdef SIF_CLI_IO_URING
+
+typedef struct {
+  int fd;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void *sq_ring, *cq_ring;
+  size_t sq_ring_size, cq_ring_size, sqes_size;
+} cli_ring_t;
+
+/* Sets up a ring through the raw system calls, so that no liburing is needed. */
+bool ringInit(cli_ring_t* const ring, unsigned const entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return false;
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_size > ring->sq_ring_size)
+      ring->sq_ring_size = ring->cq_ring_size;
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_ring : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+  ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if ((ring->sq_ring == MAP_FAILED) || (ring->cq_ring == MAP_FAILED) || (ring->sqes == MAP_FAILED)) {
+    close(ring->fd);
+    return false;
+  }
+  uint8_t* const sq = (uint8_t*)ring->sq_ring;
+  uint8_t* const cq = (uint8_t*)ring->cq_ring;
+  ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return true;
+}
+
+void ringExit(cli_ring_t* const ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != ring->sq_ring)
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  munmap(ring->sq_ring, ring->sq_ring_size);
+  close(ring->fd);
+}
+
+/* Queues a read or write of the rest of the job's buffer and submits it. Callers never have more
+   requests in flight than the ring has entries, so neither queue can overflow. */
+void ringSubmit(cli_ring_t* const ring, uint8_t const opcode, cli_job_t* const job) {
+  unsigned const tail = *ring->sq_tail;
+  unsigned const index = tail & *ring->sq_mask;
+  struct io_uring_sqe* const sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  job->iov.iov_base = job->data + job->done;
+  job->iov.iov_len = job->size - job->done;
+  sqe->opcode = opcode;
+  sqe->fd = job->fd;
+  sqe->addr = (uint64_t)(uintptr_t)&job->iov;
+  sqe->len = 1u;
+  sqe->off = job->done;
+  sqe->user_data = (uint64_t)(uintptr_t)job;
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1u, __ATOMIC_RELEASE);
+  while (syscall(__NR_io_uring_enter, ring->fd, 1u, 0u, 0u, NULL, 0u) < 0) {
+    if (errno != EINTR) {
+      perror("sif: io_uring_enter");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/* Waits for the next completion, returning its job and storing its result. */
+cli_job_t* ringWait(cli_ring_t* const ring, int* const result) {
+  for (;;) {
+    unsigned const head = *ring->cq_head;
+    if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+      const struct io_uring_cqe* const cqe = &ring->cqes[head & *ring->cq_mask];
+      cli_job_t* const job = (cli_job_t*)(uintptr_t)cqe->user_data;
+      *result = cqe->res;
+      __atomic_store_n(ring->cq_head, head + 1u, __ATOMIC_RELEASE);
+      return job;
+    }
+    if ((syscall(__NR_io_uring_enter, ring->fd, 0u, 1u, IORING_ENTER_GETEVENTS, NULL, 0u) < 0) && (errno != EINTR)) {
+      perror("sif: io_uring_enter");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/* Returns true once the job's transfer is over, successfully or not, and false if it was resubmitted
+   to carry on after a short read or write. */
+bool ringComplete(cli_ring_t* const ring, uint8_t const opcode, cli_job_t* const job, int const result) {
+  if (result < 0)
+    failJob(job, (opcode == IORING_OP_READV) ? "read failed" : "write failed", -result);
+  else if (result == 0)
+    failJob(job, (opcode == IORING_OP_READV) ? "file shrank while reading" : "write failed", 0);
+  else {
+    job->done += (size_t)result;
+    if (job->done < job->size) {
+      ringSubmit(ring, opcode, job);
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif /* SIF_CLI_IO_URING */
+
+/* ---------------------------------------------------------------- stages */
+
+/* Holds a stage until every thread of the pipeline exists, so that failing to create one can stop
+   the others before any of them has work in flight. Returns false if the pipeline was stopped. */
+bool awaitPipeline(cli_pipeline_t* const pipeline) {
+  pthread_mutex_lock(&pipeline->lock);
+  while (!pipeline->running && !pipeline->stopped)
+    pthread_cond_wait(&pipeline->released, &pipeline->lock);
+  bool const running = pipeline->running;
+  pthread_mutex_unlock(&pipeline->lock);
+  return running;
+}
+
+void releasePipeline(cli_pipeline_t* const pipeline, bool const run) {
+  pthread_mutex_lock(&pipeline->lock);
+  pipeline->running = run;
+  pipeline->stopped = !run;
+  pthread_cond_broadcast(&pipeline->released);
+  pthread_mutex_unlock(&pipeline->lock);
+}
+
+void finishJob(cli_pipeline_t* const pipeline, cli_job_t* const job) {
+  closeFile(job);
+  if ((job->error != NULL) && (job->output_path != NULL))
+    unlink(job->output_path);
+  pthread_mutex_lock(&pipeline->stats.lock);
+  pipeline->stats.files++;
+  if (job->error != NULL) {
+    pipeline->stats.failures++;
+    if (job->error_number != 0)
+      fprintf(stderr, "sif: %s: %s: %s\n", job->input_path, job->error, strerror(job->error_number));
+    else
+      fprintf(stderr, "sif: %s: %s\n", job->input_path, job->error);
+  }
+  else {
+    pipeline->stats.bytes_read += job->input_size;
+    pipeline->stats.bytes_written += (job->output_path != NULL) ? job->size : 0u;
+    pipeline->stats.pixels += job->pixels;
+  }
+  pthread_mutex_unlock(&pipeline->stats.lock);
+  SIF_FREE(job->data);
+  job->data = NULL;
+}
+
+void* blockingReader(void* const argument) {
+  cli_pipeline_t* const pipeline = (cli_pipeline_t*)argument;
+  if (!awaitPipeline(pipeline))
+    return NULL;
+  for (;;) {
+    pthread_mutex_lock(&pipeline->lock);
+    cli_job_t* const job = (pipeline->next_job < pipeline->job_count) ? &pipeline->jobs[pipeline->next_job++] : NULL;
+    pthread_mutex_unlock(&pipeline->lock);
+    if (job == NULL)
+      break;
+    if (openInput(job)) {
+      while (job->done < job->size) {
+        ssize_t const result = pread(job->fd, job->data + job->done, job->size - job->done, (off_t)job->done);
+        if ((result < 0) && (errno == EINTR))
+          continue;
+        if (result <= 0) {
+          failJob(job, (result < 0) ? "read failed" : "file shrank while reading", (result < 0) ? errno : 0);
+          break;
+        }
+        job->done += (size_t)result;
+      }
+    }
+    closeFile(job);
+    queuePush(&pipeline->loaded, job);
+  }
+  pthread_mutex_lock(&pipeline->lock);
+  bool const last = --pipeline->active_readers == 0u;
+  pthread_mutex_unlock(&pipeline->lock);
+  if (last)
+    queueClose(&pipeline->loaded);
+  return NULL;
+}
+
+void* blockingWriter(void* const argument) {
+  cli_pipeline_t* const pipeline = (cli_pipeline_t*)argument;
+  if (!awaitPipeline(pipeline))
+    return NULL;
+  cli_job_t* job;
+  while ((job = queuePop(&pipeline->processed, true)) != NULL) {
+    if ((job->error == NULL) && (job->output_path != NULL) && openOutput(job)) {
+      while (job->done < job->size) {
+        ssize_t const result = pwrite(job->fd, job->data + job->done, job->size - job->done, (off_t)job->done);
+        if ((result < 0) && (errno == EINTR))
+          continue;
+        if (result <= 0) {
+          failJob(job, "write failed", (result < 0) ? errno : 0);
+          break;
+        }
+        job->done += (size_t)result;
+      }
+    }
+    finishJob(pipeline, job);
+  }
+  return NULL;
+}
+
+#ifdef SIF_CLI_IO_URING
+
+void* ringReader(void* const argument) {
+  cli_pipeline_t* const pipeline = (cli_pipeline_t*)argument;
+  if (!awaitPipeline(pipeline))
+    return NULL;
+  cli_ring_t ring;
+  if (!ringInit(&ring, SIF_CLI_RING_DEPTH))
+    return blockingReader(argument);
+  size_t in_flight = 0u;
+  while ((pipeline->next_job < pipeline->job_count) || (in_flight > 0u)) {
+    while ((pipeline->next_job < pipeline->job_count) && (in_flight < SIF_CLI_RING_DEPTH)) {
+      cli_job_t* const job = &pipeline->jobs[pipeline->next_job++];
+      if (openInput(job) && (job->size > 0u)) {
+        ringSubmit(&ring, IORING_OP_READV, job);
+        in_flight++;
+      }
+      else {
+        closeFile(job);
+        queuePush(&pipeline->loaded, job);
+      }
+    }
+    if (in_flight == 0u)
+      continue;
+    int result;
+    cli_job_t* const job = ringWait(&ring, &result);
+    if (ringComplete(&ring, IORING_OP_READV, job, result)) {
+      in_flight--;
+      closeFile(job);
+      queuePush(&pipeline->loaded, job);
+    }
+  }
+  ringExit(&ring);
+  queueClose(&pipeline->loaded);
+  return NULL;
+}
+
+void* ringWriter(void* const argument) {
+  cli_pipeline_t* const pipeline = (cli_pipeline_t*)argument;
+  if (!awaitPipeline(pipeline))
+    return NULL;
+  cli_ring_t ring;
+  if (!ringInit(&ring, SIF_CLI_RING_DEPTH))
+    return blockingWriter(argument);
+  size_t in_flight = 0u;
+  for (;;) {
+    /* only block on the queue when there is nothing in flight to reap instead */
+    cli_job_t* job = (in_flight < SIF_CLI_RING_DEPTH) ? queuePop(&pipeline->processed, in_flight == 0u) : NULL;
+    if (job != NULL) {
+      if ((job->error == NULL) && (job->output_path != NULL) && openOutput(job) && (job->size > 0u)) {
+        ringSubmit(&ring, IORING_OP_WRITEV, job);
+        in_flight++;
+      }
+      else
+        finishJob(pipeline, job);
+      continue;
+    }
+    if (in_flight == 0u)
+      break;
+    int result;
+    job = ringWait(&ring, &result);
+    if (ringComplete(&ring, IORING_OP_WRITEV, job, result)) {
+      in_flight--;
+      finishJob(pipeline, job);
+    }
+  }
+  ringExit(&ring);
+  return NULL;
+}
+
+#endif /* SIF_CLI_IO_URING */
+
+/* ---------------------------------------------------------------- codec */
+
+typedef struct {
+  uint8_t* data;
+  size_t capacity;
+} cli_scratch_t;
+
+uint8_t* reserveScratch(cli_scratch_t* const scratch, uint64_t const size) {
+  if (size > SIZE_MAX)
+    return NULL;
+  if (size > scratch->capacity) {
+    free(scratch->data);
+    scratch->data = (uint8_t*)malloc((size_t)size);
+    scratch->capacity = (scratch->data != NULL) ? (size_t)size : 0u;
+  }
+  return scratch->data;
+}
+
+/* The rows --auto compresses to compare flags: a few strips spread over the image, copied one
+   after another into the scratch memory. */
+typedef struct {
+  SIF_content_descriptor_t strip;
+  size_t count;
+  const uint8_t* pixels;
+} cli_sample_t;
+
+/* Sizes the sample for the image and returns the scratch memory for its pixels, plus one line. */
+uint8_t* initSample(cli_sample_t* const sample, const SIF_content_descriptor_t* const image, cli_scratch_t* const scratch) {
+  sample->strip = *image;
+  sample->count = 1u;
+  if (image->height > SIF_CLI_AUTO_STRIPS * SIF_CLI_AUTO_STRIP_HEIGHT) {
+    sample->strip.height = SIF_CLI_AUTO_STRIP_HEIGHT;
+    sample->count = SIF_CLI_AUTO_STRIPS;
+  }
+  uint64_t const line_size = (uint64_t)image->width * image->channels;
+  uint8_t* const pixels = reserveScratch(scratch, line_size * (sample->count * sample->strip.height + 1u));
+  sample->pixels = pixels;
+  return pixels;
+}
+
+/* First image row of strip i; strips only overlap when there is a single one. */
+size_t sampleRow(const cli_sample_t* const sample, ULEB128_t const height, size_t const i) {
+  return (sample->count > 1u) ? (height - sample->strip.height) * i / (sample->count - 1u) : 0u;
+}
+
+bool samplePPM(cli_sample_t* const sample, const cli_job_t* const job, cli_scratch_t* const scratch) {
+  SIF_content_descriptor_t image;
+  size_t const position = SIF_readPPMHeader(job->data, job->size, &image);
+  uint8_t* const pixels = (position > 0u) ? initSample(sample, &image, scratch) : NULL;
+  if (pixels == NULL)
+    return false;
+  size_t const stride = (size_t)image.width * image.channels;
+  size_t const strip_size = (size_t)sample->strip.height * stride;
+  for (size_t i = 0u; i < sample->count; i++)
+    memcpy(&pixels[i * strip_size], &job->data[position + sampleRow(sample, image.height, i) * stride], strip_size);
+  return true;
+}
+
+/* Spreads the strips over the top SIF_CLI_AUTO_QOI_LINES lines only and decodes the QOI stream up
+   to the end of the last one, a line at a time, keeping just the sampled lines, so that sampling a
+   tall image costs a bounded part of a full decode and the image is never held as RGB. */
+bool sampleQOI(cli_sample_t* const sample, const cli_job_t* const job, cli_scratch_t* const scratch) {
+  if (job->size < SIF_QOI_HEADER_SIZE + SIF_QOI_PADDING_SIZE)
+    return false;
+  SIF_content_descriptor_t image;
+  image.width = SIF_readBigEndian32(&job->data[4]);
+  image.height = SIF_readBigEndian32(&job->data[8]);
+  image.channels = 3u;
+  image.flags = 0u;
+  if ((image.width == 0u) || (image.width > SIF_MAX_DIMENSION) || (image.height == 0u) || (image.height > SIF_MAX_DIMENSION))
+    return false;
+  if (image.height > SIF_CLI_AUTO_QOI_LINES)
+    image.height = SIF_CLI_AUTO_QOI_LINES;
+  uint8_t* const pixels = initSample(sample, &image, scratch);
+  if (pixels == NULL)
+    return false;
+  size_t const stride = (size_t)image.width * image.channels;
+  uint8_t* const line = &pixels[sample->count * sample->strip.height * stride];
+  SIF_qoi_state_t qoi;
+  SIF_initQOIState(&qoi, SIF_QOI_HEADER_SIZE);
+  size_t strip = 0u, sampled = 0u;
+  for (size_t y = 0u; strip < sample->count; y++) {
+    size_t const start = sampleRow(sample, image.height, strip);
+    uint8_t* const dst = (y >= start) ? &pixels[sampled++ * stride] : line;
+    if (!SIF_decodeQOIPixels(&qoi, job->data, job->size - SIF_QOI_PADDING_SIZE, dst, image.width))
+      return false;
+    if (y + 1u == start + sample->strip.height)
+      strip++;
+  }
+  return true;
+}
+
+/* Compressed size of the sample with the given flags, as a cheap estimate for comparing them. */
+uint64_t sampleSize(const cli_sample_t* const sample, uint8_t const flags, uint32_t const options) {
+  SIF_content_descriptor_t strip = sample->strip;
+  strip.flags = flags;
+  size_t const strip_size = (size_t)strip.height * strip.width * strip.channels;
+  uint64_t total = 0u;
+  for (size_t i = 0u; i < sample->count; i++) {
+    uint64_t size;
+    void* const data = SIF_compressImageEx(&strip, &sample->pixels[i * strip_size], strip_size, &size, options);
+    if (data == NULL)
+      return UINT64_MAX;
+    SIF_FREE(data);
+    total += size;
+  }
+  return total;
+}
+
+/* Picks the predictor and 2D prediction first and then the delta bias, greedily, comparing the
+   compressed size of the sample. The tile height and contextual dictionary keep their values
+   from --flags. */
+uint8_t chooseFlags(const cli_sample_t* const sample, uint8_t const flags, uint32_t const options) {
+  uint8_t best = flags;
+  uint64_t best_size = sampleSize(sample, best, options);
+  uint8_t const base = flags & ~(SIF_FLAGS_MASK_PREDICTOR_ID | SIF_FLAGS_MASK_2D_PREDICTOR);
+  for (unsigned predictor = SIF_predictor_direct; predictor <= SIF_predictor_decorrelate_from_blue; predictor++) {
+    for (unsigned prediction_2d = 0u; prediction_2d <= ((predictor != SIF_predictor_direct) ? 1u : 0u); prediction_2d++) {
+      uint8_t const candidate = base | (uint8_t)(predictor << SIF_FLAGS_SHIFT_PREDICTOR_ID) | (uint8_t)(prediction_2d << SIF_FLAGS_SHIFT_2D_PREDICTOR);
+      if (candidate == flags)
+        continue;
+      uint64_t const size = sampleSize(sample, candidate, options);
+      if (size < best_size) {
+        best = candidate;
+        best_size = size;
+      }
+    }
+  }
+  uint8_t const chosen = best;
+  for (unsigned bias = SIF_delta_red_bias; bias <= SIF_delta_blue_bias; bias++) {
+    uint8_t const candidate = (chosen & ~SIF_FLAGS_MASK_DELTA_BIAS) | (uint8_t)(bias << SIF_FLAGS_SHIFT_DELTA_BIAS);
+    if (candidate == chosen)
+      continue;
+    uint64_t const size = sampleSize(sample, candidate, options);
+    if (size < best_size) {
+      best = candidate;
+      best_size = size;
+    }
+  }
+  return best;
+}
+
+/* With --auto the flags are chosen from the sample before the image's one and only encode. */
+void* encode(const cli_config_t* const config, cli_job_t* const job, cli_scratch_t* const scratch, uint64_t* const outSize) {
+  bool const qoi = (job->size >= 4u) && (memcmp(job->data, "qoif", 4u) == 0);
+  uint8_t flags = config->flags;
+  if (config->auto_flags) {
+    cli_sample_t sample;
+    if ((qoi) ? sampleQOI(&sample, job, scratch) : samplePPM(&sample, job, scratch))
+      flags = chooseFlags(&sample, config->flags, config->options);
+  }
+  return (qoi) ?
+    SIF_transcodeFromQOI(job->data, job->size, flags, config->options, outSize) :
+    SIF_transcodeFromPPM(job->data, job->size, flags, config->options, outSize);
+}
+
+/* SIF_verify has already checked the header fields and data of slices with a checksum, so those need no decode. */
+bool allSlicesChecksummed(const cli_job_t* const job, cli_scratch_t* const scratch, SIF_probe_info_t* const info) {
+  if (!info->extended)
+    return false;
+  SIF_slice_info_t* const slices = (SIF_slice_info_t*)reserveScratch(scratch, (uint64_t)info->slice_count * sizeof(SIF_slice_info_t));
+  if ((slices == NULL) || !SIF_probeSlices(job->data, job->size, info, slices, info->slice_count))
+    return false;
+  for (size_t i = 0u; i < info->slice_count; i++) {
+    if ((slices[i].extended_flags & SIF_EXTENDED_FLAGS_MASK_CHECKSUM) == 0u)
+      return false;
+  }
+  return true;
+}
+
+void processJob(const cli_config_t* const config, cli_job_t* const job, cli_scratch_t* const scratch) {
+  if (job->error != NULL)
+    return;
+  uint64_t size = 0u;
+  uint8_t* output = NULL;
+  SIF_probe_info_t info;
+  memset(&info, 0, sizeof(info));
+  switch (config->mode) {
+    case mode_encode: {
+      output = (uint8_t*)encode(config, job, scratch, &size);
+      if ((output == NULL) || !SIF_probe(output, (size_t)size, &info)) {
+        SIF_FREE(output);
+        failJob(job, "not a valid 24-bit PPM or opaque QOI image", 0);
+        return;
+      }
+      break;
+    }
+    case mode_decode: {
+      if (SIF_probe(job->data, job->size, &info))
+        output = (config->to_qoi) ? (uint8_t*)SIF_transcodeToQOI(job->data, job->size, &size) : (uint8_t*)SIF_transcodeToPPM(job->data, job->size, &size);
+      if (output == NULL) {
+        failJob(job, "not a valid SIF image", 0);
+        return;
+      }
+      break;
+    }
+    case mode_verify: {
+      /* structure and checksums first, then a full decode only for images with slices stored without checksums */
+      if (!SIF_verify(job->data, job->size) || !SIF_probeSlices(job->data, job->size, &info, NULL, 0u)) {
+        failJob(job, "corrupt or not a SIF image", 0);
+        return;
+      }
+      if (!allSlicesChecksummed(job, scratch, &info)) {
+        SIF_content_descriptor_t image;
+        uint8_t* const decoded = reserveScratch(scratch, (uint64_t)info.image.width * info.image.height * info.image.channels);
+        if ((decoded == NULL) || (SIF_decompressImageInto(&image, job->data, job->size, decoded, scratch->capacity) == 0u)) {
+          failJob(job, "corrupt or not a SIF image", 0);
+          return;
+        }
+      }
+      break;
+    }
+  }
+  job->pixels = (uint64_t)info.image.width * info.image.height;
+  SIF_FREE(job->data);
+  job->data = output;
+  job->size = (size_t)size;
+}
+
+void* worker(void* const argument) {
+  cli_pipeline_t* const pipeline = (cli_pipeline_t*)argument;
+  if (!awaitPipeline(pipeline))
+    return NULL;
+  cli_scratch_t scratch = { NULL, 0u };
+  double busy = 0.0;
+  cli_job_t* job;
+  while ((job = queuePop(&pipeline->loaded, true)) != NULL) {
+    double const start = now();
+    processJob(pipeline->config, job, &scratch);
+    busy += now() - start;
+    queuePush(&pipeline->processed, job);
+  }
+  free(scratch.data);
+  pthread_mutex_lock(&pipeline->stats.lock);
+  pipeline->stats.codec_seconds += busy;
+  pthread_mutex_unlock(&pipeline->stats.lock);
+  pthread_mutex_lock(&pipeline->lock);
+  bool const last = --pipeline->active_workers == 0u;
+  pthread_mutex_unlock(&pipeline->lock);
+  if (last)
+    queueClose(&pipeline->processed);
+  return NULL;
+}
+
+/* ---------------------------------------------------------------- file tree */
+
+typedef struct {
+  cli_job_t* items;
+  size_t count, capacity;
+} cli_job_list_t;
+
+char* joinPath(const char* const directory, const char* const name) {
+  size_t const length = strlen(directory);
+  char* const path = (char*)malloc(length + strlen(name) + 2u);
+  if (path != NULL)
+    sprintf(path, ((length > 0u) && (directory[length - 1u] == '/')) ? "%s%s" : "%s/%s", directory, name);
+  return path;
+}
+
+bool hasExtension(const char* const name, const char* const extension) {
+  size_t const length = strlen(name), extension_length = strlen(extension);
+  return (length > extension_length) && (strcasecmp(&name[length - extension_length], extension) == 0);
+}
+
+/* Replaces the extension of the file name, if any, with the given one. */
+char* outputName(const char* const directory, const char* const name, const char* const extension) {
+  const char* const dot = strrchr(name, '.');
+  size_t const stem = ((dot != NULL) && (dot != name)) ? (size_t)(dot - name) : strlen(name);
+  char* const renamed = (char*)malloc(stem + strlen(extension) + 1u);
+  if (renamed == NULL)
+    return NULL;
+  memcpy(renamed, name, stem);
+  strcpy(&renamed[stem], extension);
+  char* const path = joinPath(directory, renamed);
+  free(renamed);
+  return path;
+}
+
+bool makeDirectories(const char* const path) {
+  char* const copy = strdup(path);
+  if (copy == NULL)
+    return false;
+  for (char* p = copy + 1; ; p++) {
+    if ((*p == '/') || (*p == '\0')) {
+      char const c = *p;
+      *p = '\0';
+      if ((mkdir(copy, 0777) != 0) && (errno != EEXIST)) {
+        fprintf(stderr, "sif: cannot create %s: %s\n", copy, strerror(errno));
+        free(copy);
+        return false;
+      }
+      *p = c;
+      if (c == '\0')
+        break;
+    }
+  }
+  free(copy);
+  return true;
+}
+
+bool addJob(cli_job_list_t* const list, const cli_config_t* const config, const char* const input_directory, const char* const output_directory, const char* const name) {
+  if (list->count == list->capacity) {
+    size_t const capacity = (list->capacity > 0u) ? list->capacity * 2u : 64u;
+    cli_job_t* const items = (cli_job_t*)realloc(list->items, capacity * sizeof(cli_job_t));
+    if (items == NULL)
+      return false;
+    list->items = items;
+    list->capacity = capacity;
+  }
+  cli_job_t* const job = &list->items[list->count];
+  memset(job, 0, sizeof(*job));
+  job->fd = -1;
+  job->input_path = joinPath(input_directory, name);
+  if (job->input_path == NULL)
+    return false;
+  if (config->mode != mode_verify) {
+    job->output_path = outputName(output_directory, name, (config->mode == mode_encode) ? ".sif" : (config->to_qoi) ? ".qoi" : ".ppm");
+    if (job->output_path == NULL)
+      return false;
+  }
+  list->count++;
+  return true;
+}
+
+bool acceptsFile(const cli_config_t* const config, const char* const name) {
+  if (config->mode == mode_encode)
+    return hasExtension(name, ".ppm") || hasExtension(name, ".qoi");
+  return hasExtension(name, ".sif");
+}
+
+/* Collects the matching files under input_directory, mirroring its layout under output_directory,
+   which is created as needed (output_directory is NULL when verifying). Symbolic links to
+   directories are not followed. */
+bool collectJobs(cli_job_list_t* const list, const cli_config_t* const config, const char* const input_directory, const char* const output_directory) {
+  DIR* const directory = opendir(input_directory);
+  if (directory == NULL) {
+    fprintf(stderr, "sif: cannot open %s: %s\n", input_directory, strerror(errno));
+    return false;
+  }
+  bool result = true, created = (output_directory == NULL);
+  struct dirent* entry;
+  while (result && ((entry = readdir(directory)) != NULL)) {
+    if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+      continue;
+    char* const path = joinPath(input_directory, entry->d_name);
+    struct stat info;
+    if ((path == NULL) || (lstat(path, &info) != 0) || (S_ISLNK(info.st_mode) && (stat(path, &info) != 0))) {
+      free(path);
+      continue;
+    }
+    if (S_ISDIR(info.st_mode) && (lstat(path, &info) == 0) && S_ISDIR(info.st_mode)) {
+      char* const output = (output_directory != NULL) ? joinPath(output_directory, entry->d_name) : NULL;
+      result = ((output_directory == NULL) || (output != NULL)) && collectJobs(list, config, path, output);
+      free(output);
+    }
+    else if (S_ISREG(info.st_mode) && acceptsFile(config, entry->d_name)) {
+      if (!created)
+        created = result = makeDirectories(output_directory);
+      result = result && addJob(list, config, input_directory, output_directory, entry->d_name);
+    }
+    free(path);
+  }
+  closedir(directory);
+  return result;
+}
+
+int compareOutputPaths(const void* const a, const void* const b) {
+  return strcmp((*(const cli_job_t* const*)a)->output_path, (*(const cli_job_t* const*)b)->output_path);
+}
+
+/* Inputs that only differ in their extension, e.g. x.ppm and x.qoi, map to the same output and
+   would be written concurrently, so such a run is refused before any file is written. */
+bool checkOutputPaths(const cli_job_list_t* const list) {
+  if (list->count < 2u)
+    return true;
+  const cli_job_t** const sorted = (const cli_job_t**)malloc(list->count * sizeof(*sorted));
+  if (sorted == NULL)
+    return false;
+  for (size_t i = 0u; i < list->count; i++)
+    sorted[i] = &list->items[i];
+  qsort(sorted, list->count, sizeof(*sorted), compareOutputPaths);
+  bool result = true;
+  for (size_t i = 1u; i < list->count; i++) {
+    if (strcmp(sorted[i - 1u]->output_path, sorted[i]->output_path) == 0) {
+      fprintf(stderr, "sif: %s and %s would both be written to %s\n", sorted[i - 1u]->input_path, sorted[i]->input_path, sorted[i]->output_path);
+      result = false;
+    }
+  }
+  free(sorted);
+  return result;
+}
+
+/* ---------------------------------------------------------------- main */
+
+void usage(void) {
+  fprintf(stderr,
+    "usage: sif encode [options] <input> <output directory>\n"
+    "       sif decode [options] <input> <output directory>\n"
+    "       sif verify [options] <input>\n"
+    "\n"
+    "<input> is a file or a directory tree. encode takes PPM (P6) and opaque QOI images,\n"
+    "decode and verify take SIF images; outputs keep the input layout and file names.\n"
+    "\n"
+    "  --threads N     codec worker threads (default: number of online processors)\n"
+    "  --queue N       loaded files waiting for a worker, bounding memory (default: 2 per thread)\n"
+    "  --flags N       slice flags for encoding (default: 0x%02X)\n"
+    "  --auto          pick the predictor and delta bias per image from a sample of it,\n"
+    "                  taken from the top 1024 lines of QOI inputs\n"
+    "  --optimal       optimal parse, smaller output at a higher encoding cost\n"
+    "  --checksum      store a CRC32C of each slice\n"
+    "  --dict-ways N   dictionary associativity, 1, 2 or 4 (default: 1)\n"
+    "  --large-dict    4x as many contextual dictionary buckets\n"
+    "  --qoi           decode to QOI instead of PPM\n"
+    "  --no-io-uring   use blocking I/O threads even where io_uring is available\n",
+    SIF_CLI_DEFAULT_FLAGS);
+}
+
+bool parseNumber(const char* const text, unsigned long const maximum, unsigned long* const value) {
+  char* end;
+  errno = 0;
+  *value = strtoul(text, &end, 0);
+  return (errno == 0) && (end != text) && (*end == '\0') && (*value <= maximum);
+}
+
+int main(int argc, char** argv) {
+  cli_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.flags = SIF_CLI_DEFAULT_FLAGS;
+  config.use_io_uring = true;
+  long const processors = sysconf(_SC_NPROCESSORS_ONLN);
+  config.threads = (processors > 0) ? (size_t)processors : 1u;
+
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  if (strcmp(argv[1], "encode") == 0)
+    config.mode = mode_encode;
+  else if (strcmp(argv[1], "decode") == 0)
+    config.mode = mode_decode;
+  else if (strcmp(argv[1], "verify") == 0)
+    config.mode = mode_verify;
+  else {
+    usage();
+    return 2;
+  }
+  const char* paths[2] = { NULL, NULL };
+  size_t path_count = 0u;
+  for (int i = 2; i < argc; i++) {
+    unsigned long value;
+    if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc) && parseNumber(argv[i + 1], 1024u, &value) && (value > 0u)) {
+      config.threads = (size_t)value;
+      i++;
+    }
+    else if ((strcmp(argv[i], "--queue") == 0) && (i + 1 < argc) && parseNumber(argv[i + 1], 65536u, &value) && (value > 0u)) {
+      config.queue_capacity = (size_t)value;
+      i++;
+    }
+    else if ((strcmp(argv[i], "--flags") == 0) && (i + 1 < argc) && parseNumber(argv[i + 1], 0xFFu, &value)) {
+      config.flags = (uint8_t)value;
+      i++;
+    }
+    else if (strcmp(argv[i], "--auto") == 0)
+      config.auto_flags = true;
+    else if (strcmp(argv[i], "--optimal") == 0)
+      config.options |= SIF_option_optimal_parse;
+    else if (strcmp(argv[i], "--checksum") == 0)
+      config.options |= SIF_option_slice_checksum;
+    else if ((strcmp(argv[i], "--dict-ways") == 0) && (i + 1 < argc) && parseNumber(argv[i + 1], 4u, &value) && (value > 0u) && (value != 3u)) {
+      config.options &= ~(uint32_t)(SIF_option_dict_2way | SIF_option_dict_4way);
+      config.options |= (value == 4u) ? SIF_option_dict_4way : (value == 2u) ? SIF_option_dict_2way : SIF_option_none;
+      i++;
+    }
+    else if (strcmp(argv[i], "--large-dict") == 0)
+      config.options |= SIF_option_dict_large;
+    else if (strcmp(argv[i], "--qoi") == 0)
+      config.to_qoi = true;
+    else if (strcmp(argv[i], "--no-io-uring") == 0)
+      config.use_io_uring = false;
+    else if ((argv[i][0] != '-') && (path_count < 2u))
+      paths[path_count++] = argv[i];
+    else {
+      fprintf(stderr, "sif: invalid argument %s\n\n", argv[i]);
+      usage();
+      return 2;
+    }
+  }
+  if (path_count != ((config.mode == mode_verify) ? 1u : 2u)) {
+    usage();
+    return 2;
+  }
+  if (config.queue_capacity == 0u)
+    config.queue_capacity = config.threads * 2u;
+
+  cli_job_list_t list = { NULL, 0u, 0u };
+  struct stat info;
+  if (stat(paths[0], &info) != 0) {
+    fprintf(stderr, "sif: cannot open %s: %s\n", paths[0], strerror(errno));
+    return 1;
+  }
+  bool collected;
+  if (S_ISDIR(info.st_mode))
+    collected = collectJobs(&list, &config, paths[0], paths[1]);
+  else {
+    /* a single file is taken whatever its extension, and goes into the output directory */
+    char* const copy = strdup(paths[0]);
+    char* const slash = (copy != NULL) ? strrchr(copy, '/') : NULL;
+    const char* const name = (slash != NULL) ? slash + 1 : copy;
+    if (slash != NULL)
+      *slash = '\0';
+    collected = (copy != NULL) && ((paths[1] == NULL) || makeDirectories(paths[1])) && addJob(&list, &config, (slash == NULL) ? "." : (slash == copy) ? "/" : copy, paths[1], name);
+    free(copy);
+  }
+  if (!collected) {
+    fprintf(stderr, "sif: cannot collect the input files\n");
+    return 1;
+  }
+  if ((config.mode != mode_verify) && !checkOutputPaths(&list))
+    return 1;
+
+  cli_pipeline_t pipeline;
+  memset(&pipeline, 0, sizeof(pipeline));
+  pipeline.config = &config;
+  pipeline.jobs = list.items;
+  pipeline.job_count = list.count;
+  pipeline.active_workers = config.threads;
+  queueInit(&pipeline.loaded, config.queue_capacity);
+  queueInit(&pipeline.processed, config.queue_capacity);
+  pthread_mutex_init(&pipeline.lock, NULL);
+  pthread_cond_init(&pipeline.released, NULL);
+  pthread_mutex_init(&pipeline.stats.lock, NULL);
+
+  void* (*reader)(void*) = blockingReader;
+  void* (*writer)(void*) = blockingWriter;
+  size_t io_threads = SIF_CLI_IO_THREADS;
+  const char* io = "blocking I/O threads";
+#ifdef SIF_CLI_IO_URING
+  if (config.use_io_uring) {
+    /* each ring stage falls back to blocking I/O on its own if its ring cannot be set up */
+    cli_ring_t probe;
+    if (ringInit(&probe, 1u)) {
+      ringExit(&probe);
+      reader = ringReader;
+      writer = ringWriter;
+      io_threads = 1u;
+      io = "io_uring";
+    }
+  }
+#endif
+  pipeline.active_readers = io_threads;
+  size_t const thread_count = io_threads * 2u + config.threads;
+  pthread_t* const threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+  if (threads == NULL) {
+    fprintf(stderr, "sif: out of memory\n");
+    return 1;
+  }
+  double const start = now();
+  size_t started = 0u;
+  bool spawned = true;
+  for (size_t i = 0u; spawned && (i < thread_count); i++) {
+    void* (*routine)(void*) = (i < io_threads) ? reader : (i < io_threads * 2u) ? writer : worker;
+    spawned = pthread_create(&threads[i], NULL, routine, &pipeline) == 0;
+    started += spawned;
+  }
+  /* the threads that did start return right away if the pipeline is stopped, and must be joined
+     before it goes out of scope */
+  releasePipeline(&pipeline, spawned);
+  for (size_t i = 0u; i < started; i++)
+    pthread_join(threads[i], NULL);
+  if (!spawned) {
+    fprintf(stderr, "sif: cannot start threads\n");
+    return 1;
+  }
+  double const elapsed = now() - start;
+
+  const cli_stats_t* const stats = &pipeline.stats;
+  double const seconds = (elapsed > 0.0) ? elapsed : 1e-9;
+  static const char* const verbs[] = { "encoded", "decoded", "verified" };
+  printf("%s %llu of %llu files in %.3f s with %zu threads and %s\n", verbs[config.mode], (unsigned long long)(stats->files - stats->failures), (unsigned long long)stats->files, elapsed, config.threads, io);
+  printf("  read    %10.1f MB  %8.1f MB/s\n", (double)stats->bytes_read * 1e-6, (double)stats->bytes_read * 1e-6 / seconds);
+  if (config.mode != mode_verify)
+    printf("  written %10.1f MB  %8.1f MB/s  (%.1f%% of input)\n", (double)stats->bytes_written * 1e-6, (double)stats->bytes_written * 1e-6 / seconds, (stats->bytes_read > 0u) ? 100.0 * (double)stats->bytes_written / (double)stats->bytes_read : 0.0);
+  printf("  pixels  %10.1f MP  %8.1f MP/s\n", (double)stats->pixels * 1e-6, (double)stats->pixels * 1e-6 / seconds);
+  printf("  codec   %10.3f s   %8.1f%% of worker time\n", stats->codec_seconds, 100.0 * stats->codec_seconds / (seconds * (double)config.threads));
+
+  for (size_t i = 0u; i < list.count; i++) {
+    free(list.items[i].input_path);
+    free(list.items[i].output_path);
+  }
+  free(list.items);
+  free(threads);
+  queueFree(&pipeline.loaded);
+  queueFree(&pipeline.processed);
+  pthread_mutex_destroy(&pipeline.lock);
+  pthread_cond_destroy(&pipeline.released);
+  pthread_mutex_destroy(&pipeline.stats.lock);
+  return (stats->failures > 0u) ? 1 : 0;
+}
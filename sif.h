@@ -44,16 +44,91 @@ typedef struct {
   uint8_t flags;
 } SIF_content_descriptor_t;
 
+typedef enum {
+  SIF_option_none           = 0x00,
+  SIF_option_optimal_parse  = 0x01, /* slower encoding, smaller output, standard bitstream */
+  SIF_option_slice_checksum = 0x02, /* store a CRC32C of each slice's header fields and data */
+  SIF_option_dict_2way      = 0x04, /* set-associative dictionary, more single-byte hits on screen content */
+  SIF_option_dict_4way      = 0x08, /* takes precedence over SIF_option_dict_2way */
+  SIF_option_dict_large     = 0x10  /* 4x as many contextual dictionary buckets, with SIF_FLAGS_MASK_CONTEXTUAL_DICT */
+} SIF_options;
+
+#define SIF_PROBE_HEADER_SIZE 10u /* enough for the magic number and the ULEB128 width and height */
+
+typedef struct {
+  SIF_content_descriptor_t image; /* flags are left at 0, see SIF_slice_info_t for the per-slice flags */
+  uint32_t slice_count; /* only counted by the *Slices variants */
+  bool extended; /* slice headers carry extended flags, e.g. checksums */
+} SIF_probe_info_t;
+
+typedef struct {
+  uint64_t offset; /* of the slice data from the start of the image */
+  uint32_t size; /* compressed size, end of slice marker included */
+  ULEB128_t height;
+  uint8_t flags;
+  uint8_t extended_flags;
+} SIF_slice_info_t;
+
 void* SIF_compressImage(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize);
 
+void* SIF_compressImageEx(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize, uint32_t const options);
+
 void* SIF_decompressImage(SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize);
 
+uint64_t SIF_compressImageInto(const SIF_content_descriptor_t* const image, const void* const src, size_t const stride, uint32_t const options, void** dst, size_t* dstCapacity);
+
+uint64_t SIF_decompressImageInto(SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, void* const dst, size_t const dstCapacity);
+
+uint64_t SIF_decompressImageIntoEx(SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, void* const dst, size_t const dstCapacity, size_t const stride);
+
+/* Encoder and decoder state, tens of KB each, which the functions above allocate for every image.
+   Callers handling a stream of images can create them once and pass them to the *With* variants. */
+typedef struct SIF_slice_encoder_s SIF_slice_encoder_t;
+
+typedef struct SIF_slice_decoder_s SIF_slice_decoder_t;
+
+SIF_slice_encoder_t* SIF_createEncoder(void);
+
+void SIF_freeEncoder(SIF_slice_encoder_t* const encoder);
+
+SIF_slice_decoder_t* SIF_createDecoder(void);
+
+void SIF_freeDecoder(SIF_slice_decoder_t* const decoder);
+
+uint64_t SIF_compressImageWithEncoder(SIF_slice_encoder_t* const encoder, const SIF_content_descriptor_t* const image, const void* const src, size_t const stride, uint32_t const options, void** dst, size_t* dstCapacity);
+
+uint64_t SIF_decompressImageWithDecoder(SIF_slice_decoder_t* const decoder, SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, void* const dst, size_t const dstCapacity, size_t const stride);
+
+void SIF_free(void* const data);
+
+bool SIF_verify(const void* const src, size_t const srcSize);
+
+bool SIF_probe(const void* const src, size_t const srcSize, SIF_probe_info_t* const info);
+
+bool SIF_probeSlices(const void* const src, size_t const srcSize, SIF_probe_info_t* const info, SIF_slice_info_t* const slices, size_t const maxSlices);
+
+#ifndef SIF_NO_TRANSCODERS
+
+void* SIF_transcodeFromQOI(const void* const src, size_t const srcSize, uint8_t const flags, uint32_t const options, uint64_t* outSize);
+
+void* SIF_transcodeToQOI(const void* const src, size_t const srcSize, uint64_t* outSize);
+
+void* SIF_transcodeFromPPM(const void* const src, size_t const srcSize, uint8_t const flags, uint32_t const options, uint64_t* outSize);
+
+void* SIF_transcodeToPPM(const void* const src, size_t const srcSize, uint64_t* outSize);
+
+#endif /* SIF_NO_TRANSCODERS */
+
 #ifndef SIF_NO_STDIO
 
 uint64_t SIF_write(const char* const filename, const void* const data, size_t const srcSize, const SIF_content_descriptor_t* const descriptor);
 
 void* SIF_read(const char* const filename, SIF_content_descriptor_t* const descriptor, uint64_t* outSize);
 
+bool SIF_probeFile(const char* const filename, SIF_probe_info_t* const info);
+
+bool SIF_probeFileSlices(const char* const filename, SIF_probe_info_t* const info, SIF_slice_info_t* const slices, size_t const maxSlices);
+
 #endif /* SIF_NO_STDIO */
 
 #ifdef __cplusplus
@@ -102,10 +177,15 @@ void* SIF_read(const char* const filename, SIF_content_descriptor_t* const descr
 
 #ifndef SIF_MALLOC
 #  define SIF_MALLOC(size) malloc(size)
+#  define SIF_REALLOC(pointer, size) realloc(pointer, size)
 #  define SIF_FREE(pointer) free(pointer)
 #endif
 
 #define SIF_MAGIC_NUMBER 0x51F0u
+#define SIF_MAGIC_MASK_CHANNELS 0x07u
+#define SIF_MAGIC_FLAG_EXTENDED 0x08u /* slice headers carry an extended flags byte */
+
+#define SIF_CRC32C_POLYNOMIAL 0x82F63B78u /* bit-reflected */
 #define SIF_END_OF_SLICE_MARKER ((SIF_end_of_slice_marker_t)(0))
 #define SIF_MAX_DIMENSION_BIT_LENGTH 29u
 #define SIF_MAX_DIMENSION (((ULEB128_t)(1u)) << SIF_MAX_DIMENSION_BIT_LENGTH)
@@ -127,15 +207,26 @@ void* SIF_read(const char* const filename, SIF_content_descriptor_t* const descr
 #define SIF_FLAGS_SHIFT_CONTEXTUAL_DICT 5u
 #define SIF_FLAGS_SHIFT_DELTA_BIAS      6u
 
+#define SIF_EXTENDED_FLAGS_MASK_CHECKSUM   0x01u
+#define SIF_EXTENDED_FLAGS_MASK_DICT_WAYS  0x06u
+#define SIF_EXTENDED_FLAGS_MASK_DICT_LARGE 0x08u
+#define SIF_EXTENDED_FLAGS_MASK_KNOWN      (SIF_EXTENDED_FLAGS_MASK_CHECKSUM | SIF_EXTENDED_FLAGS_MASK_DICT_WAYS | SIF_EXTENDED_FLAGS_MASK_DICT_LARGE)
+
+#define SIF_EXTENDED_FLAGS_SHIFT_DICT_WAYS 1u
+
 #define SIF_RUN_MINIMUM_LENGTH 2u
 #define SIF_RUN_CACHE_SIZE 4096u
 #define SIF_REDUCED_OFFSET_BIT_LENGTH 6u
 #define SIF_DICT_CONTEXT_BIT_LENGTH 5u
-#define SIF_DICT_NUM_OF_BUCKETS (1u << SIF_DICT_CONTEXT_BIT_LENGTH)
+#define SIF_DICT_LARGE_CONTEXT_BIT_LENGTH 7u
+#define SIF_DICT_MAX_WAYS_EXPONENT 2u
+#define SIF_DICT_NUM_OF_BUCKETS (1u << SIF_DICT_LARGE_CONTEXT_BIT_LENGTH)
 #define SIF_DICT_ITEMS_PER_BUCKET (1u << SIF_REDUCED_OFFSET_BIT_LENGTH)
 
 #define SIF_SLD_WND_MASK (SIF_TILE_WIDTH * 2u - 1u)
 
+#define SIF_OPTIMAL_PARSE_WINDOW 64u
+
 #define SIF_OPCODE_MASK(x) ((0xFFu << (8u - (x))) & 0xFFu)
 
 typedef enum {
@@ -175,15 +266,84 @@ typedef struct {
 typedef struct {
   uint32_t size; /* little-endian */
   uint8_t flags;
+  uint8_t extended_flags; /* only present if the magic number has SIF_MAGIC_FLAG_EXTENDED */
   ULEB128_t height;
+  uint32_t checksum; /* CRC32C of the slice header fields and data, only present with SIF_EXTENDED_FLAGS_MASK_CHECKSUM */
 } SIF_slice_header_t;
 
 typedef uint32_t SIF_end_of_slice_marker_t;
 
+typedef struct {
+  uint8_t* data;
+  size_t size; /* bytes in use */
+  size_t capacity;
+  bool growable;
+} SIF_buffer_t;
+
+typedef struct {
+  SIF_content_descriptor_t slice;
+  size_t predictor_id;
+  SIF_pixel_t range_8b, run_mask, range_20b, mask_20b;
+  int run_shift_g, run_shift_r, delta_20b_shift_g, delta_20b_shift_r;
+  bool use_contextual_dict, use_2d_prediction;
+  size_t dict_ways, dict_set_mask, dict_context_shift, dict_size;
+  size_t tile_height, grid_width_in_tiles, grid_height_in_tiles, remaining_columns, remaining_lines;
+} SIF_slice_parameters_t;
+
+/* Working memory of SIF_encodeRunOptimal, too large for the stack, so it lives in the encoder. */
+typedef struct {
+  uint32_t cost[SIF_RUN_CACHE_SIZE + 1u], body[SIF_RUN_CACHE_SIZE];
+  uint16_t next_nonzero[SIF_RUN_CACHE_SIZE + 1u], from[SIF_RUN_CACHE_SIZE + 1u];
+} SIF_optimal_parse_t;
+
+struct SIF_slice_encoder_s {
+  SIF_slice_parameters_t parameters;
+  uint32_t options;
+  uint8_t run_cache[SIF_RUN_CACHE_SIZE];
+  uint8_t run_hits[SIF_RUN_CACHE_SIZE];
+  SIF_optimal_parse_t parse;
+  SIF_pixel_t dict[SIF_DICT_NUM_OF_BUCKETS * SIF_DICT_ITEMS_PER_BUCKET];
+  SIF_pixel_t sld_wnd[SIF_TILE_WIDTH * 2u];
+  SIF_pixel_t prev_pixel;
+  uint32_t run, run0, sld_offset;
+  size_t base; /* offset of the slice data in the output buffer */
+  size_t position; /* relative to base */
+  size_t tile_y;
+};
+
+struct SIF_slice_decoder_s {
+  SIF_slice_parameters_t parameters;
+  uint8_t run_cache[SIF_RUN_CACHE_SIZE];
+  SIF_pixel_t dict[SIF_DICT_NUM_OF_BUCKETS * SIF_DICT_ITEMS_PER_BUCKET];
+  SIF_pixel_t sld_wnd[SIF_TILE_WIDTH * 2u];
+  SIF_pixel_t prev_pixel;
+  uint32_t run, run0, sld_offset;
+  size_t cache_index;
+  size_t position; /* relative to the start of the slice data */
+  size_t tile_y;
+};
+
 SIF_FORCE_INLINE uint32_t SIF_pixelHash(SIF_pixel_t const pixel) {
   return ((pixel.value * 0x9E3779B9u) >> (29u - SIF_REDUCED_OFFSET_BIT_LENGTH)) & (SIF_DICT_ITEMS_PER_BUCKET - 1u);
 }
 
+/* Dictionary buckets are split into sets of dict_ways consecutive entries, kept from newest to
+   oldest. A miss shifts the set by one entry, evicting the oldest, and a hit leaves it as it is,
+   so the decoder never touches the dictionary on a reduced offset opcode and the dictionary
+   still stays constant over a run, as the optimal parse relies on. */
+SIF_FORCE_INLINE size_t SIF_dictFind(const SIF_pixel_t* const set, SIF_pixel_t const pixel, size_t const ways) {
+  size_t way = 0u;
+  while ((way < ways) && (set[way].value != pixel.value))
+    way++;
+  return way;
+}
+
+SIF_FORCE_INLINE void SIF_dictInsert(SIF_pixel_t* const set, SIF_pixel_t const pixel, size_t const ways) {
+  for (size_t way = ways - 1u; way > 0u; way--)
+    set[way] = set[way - 1u];
+  set[0] = pixel;
+}
+
 SIF_FORCE_INLINE bool SIF_checkRange(int8_t const value, int8_t const range) {
   SIF_ASSERT(range >= 0);
   return (value >= -range) && (value < range);
@@ -193,7 +353,7 @@ ULEB128_t SIF_readULEB128(const void* const src, size_t* const position, size_t
   SIF_ASSERT(src != NULL);
   SIF_ASSERT(position != NULL);
   SIF_ASSERT(*position < size);
-  const uint8_t* const src_ = (const uint8_t* const)src;
+  const uint8_t* const src_ = (const uint8_t*)src;
   size_t offset = 0u;
   ULEB128_t r = 0u;
   int k = 0;
@@ -209,7 +369,7 @@ ULEB128_t SIF_readULEB128(const void* const src, size_t* const position, size_t
 
 size_t SIF_writeULEB128(void* const dst, ULEB128_t value) {
   SIF_ASSERT(dst != NULL);
-  uint8_t* const dst_ = (uint8_t* const)dst;
+  uint8_t* const dst_ = (uint8_t*)dst;
   size_t offset = 0u;
   while ((value > 0x7Fu) && (offset < sizeof(ULEB128_t) - 1u)) {
     dst_[offset++] = (uint8_t)(0x80u | (value & 0x7Fu));
@@ -220,6 +380,193 @@ size_t SIF_writeULEB128(void* const dst, ULEB128_t value) {
   return offset;
 }
 
+static const uint32_t SIF_crc32c_table[256] = {
+  0x00000000u, 0xF26B8303u, 0xE13B70F7u, 0x1350F3F4u, 0xC79A971Fu, 0x35F1141Cu, 0x26A1E7E8u, 0xD4CA64EBu,
+  0x8AD958CFu, 0x78B2DBCCu, 0x6BE22838u, 0x9989AB3Bu, 0x4D43CFD0u, 0xBF284CD3u, 0xAC78BF27u, 0x5E133C24u,
+  0x105EC76Fu, 0xE235446Cu, 0xF165B798u, 0x030E349Bu, 0xD7C45070u, 0x25AFD373u, 0x36FF2087u, 0xC494A384u,
+  0x9A879FA0u, 0x68EC1CA3u, 0x7BBCEF57u, 0x89D76C54u, 0x5D1D08BFu, 0xAF768BBCu, 0xBC267848u, 0x4E4DFB4Bu,
+  0x20BD8EDEu, 0xD2D60DDDu, 0xC186FE29u, 0x33ED7D2Au, 0xE72719C1u, 0x154C9AC2u, 0x061C6936u, 0xF477EA35u,
+  0xAA64D611u, 0x580F5512u, 0x4B5FA6E6u, 0xB93425E5u, 0x6DFE410Eu, 0x9F95C20Du, 0x8CC531F9u, 0x7EAEB2FAu,
+  0x30E349B1u, 0xC288CAB2u, 0xD1D83946u, 0x23B3BA45u, 0xF779DEAEu, 0x05125DADu, 0x1642AE59u, 0xE4292D5Au,
+  0xBA3A117Eu, 0x4851927Du, 0x5B016189u, 0xA96AE28Au, 0x7DA08661u, 0x8FCB0562u, 0x9C9BF696u, 0x6EF07595u,
+  0x417B1DBCu, 0xB3109EBFu, 0xA0406D4Bu, 0x522BEE48u, 0x86E18AA3u, 0x748A09A0u, 0x67DAFA54u, 0x95B17957u,
+  0xCBA24573u, 0x39C9C670u, 0x2A993584u, 0xD8F2B687u, 0x0C38D26Cu, 0xFE53516Fu, 0xED03A29Bu, 0x1F682198u,
+  0x5125DAD3u, 0xA34E59D0u, 0xB01EAA24u, 0x42752927u, 0x96BF4DCCu, 0x64D4CECFu, 0x77843D3Bu, 0x85EFBE38u,
+  0xDBFC821Cu, 0x2997011Fu, 0x3AC7F2EBu, 0xC8AC71E8u, 0x1C661503u, 0xEE0D9600u, 0xFD5D65F4u, 0x0F36E6F7u,
+  0x61C69362u, 0x93AD1061u, 0x80FDE395u, 0x72966096u, 0xA65C047Du, 0x5437877Eu, 0x4767748Au, 0xB50CF789u,
+  0xEB1FCBADu, 0x197448AEu, 0x0A24BB5Au, 0xF84F3859u, 0x2C855CB2u, 0xDEEEDFB1u, 0xCDBE2C45u, 0x3FD5AF46u,
+  0x7198540Du, 0x83F3D70Eu, 0x90A324FAu, 0x62C8A7F9u, 0xB602C312u, 0x44694011u, 0x5739B3E5u, 0xA55230E6u,
+  0xFB410CC2u, 0x092A8FC1u, 0x1A7A7C35u, 0xE811FF36u, 0x3CDB9BDDu, 0xCEB018DEu, 0xDDE0EB2Au, 0x2F8B6829u,
+  0x82F63B78u, 0x709DB87Bu, 0x63CD4B8Fu, 0x91A6C88Cu, 0x456CAC67u, 0xB7072F64u, 0xA457DC90u, 0x563C5F93u,
+  0x082F63B7u, 0xFA44E0B4u, 0xE9141340u, 0x1B7F9043u, 0xCFB5F4A8u, 0x3DDE77ABu, 0x2E8E845Fu, 0xDCE5075Cu,
+  0x92A8FC17u, 0x60C37F14u, 0x73938CE0u, 0x81F80FE3u, 0x55326B08u, 0xA759E80Bu, 0xB4091BFFu, 0x466298FCu,
+  0x1871A4D8u, 0xEA1A27DBu, 0xF94AD42Fu, 0x0B21572Cu, 0xDFEB33C7u, 0x2D80B0C4u, 0x3ED04330u, 0xCCBBC033u,
+  0xA24BB5A6u, 0x502036A5u, 0x4370C551u, 0xB11B4652u, 0x65D122B9u, 0x97BAA1BAu, 0x84EA524Eu, 0x7681D14Du,
+  0x2892ED69u, 0xDAF96E6Au, 0xC9A99D9Eu, 0x3BC21E9Du, 0xEF087A76u, 0x1D63F975u, 0x0E330A81u, 0xFC588982u,
+  0xB21572C9u, 0x407EF1CAu, 0x532E023Eu, 0xA145813Du, 0x758FE5D6u, 0x87E466D5u, 0x94B49521u, 0x66DF1622u,
+  0x38CC2A06u, 0xCAA7A905u, 0xD9F75AF1u, 0x2B9CD9F2u, 0xFF56BD19u, 0x0D3D3E1Au, 0x1E6DCDEEu, 0xEC064EEDu,
+  0xC38D26C4u, 0x31E6A5C7u, 0x22B65633u, 0xD0DDD530u, 0x0417B1DBu, 0xF67C32D8u, 0xE52CC12Cu, 0x1747422Fu,
+  0x49547E0Bu, 0xBB3FFD08u, 0xA86F0EFCu, 0x5A048DFFu, 0x8ECEE914u, 0x7CA56A17u, 0x6FF599E3u, 0x9D9E1AE0u,
+  0xD3D3E1ABu, 0x21B862A8u, 0x32E8915Cu, 0xC083125Fu, 0x144976B4u, 0xE622F5B7u, 0xF5720643u, 0x07198540u,
+  0x590AB964u, 0xAB613A67u, 0xB831C993u, 0x4A5A4A90u, 0x9E902E7Bu, 0x6CFBAD78u, 0x7FAB5E8Cu, 0x8DC0DD8Fu,
+  0xE330A81Au, 0x115B2B19u, 0x020BD8EDu, 0xF0605BEEu, 0x24AA3F05u, 0xD6C1BC06u, 0xC5914FF2u, 0x37FACCF1u,
+  0x69E9F0D5u, 0x9B8273D6u, 0x88D28022u, 0x7AB90321u, 0xAE7367CAu, 0x5C18E4C9u, 0x4F48173Du, 0xBD23943Eu,
+  0xF36E6F75u, 0x0105EC76u, 0x12551F82u, 0xE03E9C81u, 0x34F4F86Au, 0xC69F7B69u, 0xD5CF889Du, 0x27A40B9Eu,
+  0x79B737BAu, 0x8BDCB4B9u, 0x988C474Du, 0x6AE7C44Eu, 0xBE2DA0A5u, 0x4C4623A6u, 0x5F16D052u, 0xAD7D5351u
+};
+
+uint32_t SIF_crc32cSoftware(uint32_t crc, const uint8_t* src, size_t size) {
+  while (size-- > 0u)
+    crc = SIF_crc32c_table[(crc ^ *src++) & 0xFFu] ^ (crc >> 8u);
+  return crc;
+}
+
+#if defined(__SSE4_2__) && defined(__x86_64__)
+#  include <nmmintrin.h>
+#  define SIF_CRC32C_HARDWARE
+#  define SIF_CRC32C_HARDWARE_TARGET
+#  define SIF_CRC32C_HARDWARE_AVAILABLE() true
+#  define SIF_CRC32C_STEP(crc, value) _mm_crc32_u64(crc, value)
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#  include <nmmintrin.h>
+#  define SIF_CRC32C_HARDWARE
+#  define SIF_CRC32C_HARDWARE_TARGET __attribute__((target("sse4.2")))
+#  define SIF_CRC32C_HARDWARE_AVAILABLE() __builtin_cpu_supports("sse4.2")
+#  define SIF_CRC32C_STEP(crc, value) _mm_crc32_u64(crc, value)
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+#  include <arm_acle.h>
+#  define SIF_CRC32C_HARDWARE
+#  define SIF_CRC32C_HARDWARE_TARGET
+#  define SIF_CRC32C_HARDWARE_AVAILABLE() true
+#  define SIF_CRC32C_STEP(crc, value) __crc32cd(crc, value)
+#endif
+
+/* a(x) * b(x) modulo the CRC32C polynomial, bit-reflected; a must not be 0 */
+uint32_t SIF_crc32cMultiply(uint32_t const a, uint32_t b) {
+  uint32_t m = 1u << 31u, r = 0u;
+  for (;;) {
+    if ((a & m) > 0u) {
+      r ^= b;
+      if ((a & (m - 1u)) == 0u)
+        return r;
+    }
+    m >>= 1u;
+    b = (b & 1u) ? (b >> 1u) ^ SIF_CRC32C_POLYNOMIAL : b >> 1u;
+  }
+}
+
+#ifdef SIF_CRC32C_HARDWARE
+#define SIF_CRC32C_BLOCK_BIT_LENGTH 10u
+#define SIF_CRC32C_BLOCK_SIZE (1u << SIF_CRC32C_BLOCK_BIT_LENGTH)
+
+SIF_CRC32C_HARDWARE_TARGET uint32_t SIF_crc32cHardware(uint32_t crc, const uint8_t* src, size_t size) {
+  uint64_t crc0 = crc;
+  if (size >= 3u * SIF_CRC32C_BLOCK_SIZE) {
+    /* three independent streams hide the latency of the crc instruction, and are then
+       combined by shifting the earlier ones past the later blocks, i.e., multiplying
+       them by x^(8 * SIF_CRC32C_BLOCK_SIZE) and x^(16 * SIF_CRC32C_BLOCK_SIZE) */
+    uint32_t shift_1 = 1u << 30u; /* x^1 */
+    for (uint32_t i = 0u; i < SIF_CRC32C_BLOCK_BIT_LENGTH + 3u; i++)
+      shift_1 = SIF_crc32cMultiply(shift_1, shift_1);
+    uint32_t const shift_2 = SIF_crc32cMultiply(shift_1, shift_1);
+    do {
+      uint64_t crc1 = 0u, crc2 = 0u;
+      for (size_t i = 0u; i < SIF_CRC32C_BLOCK_SIZE; i += sizeof(uint64_t)) {
+        uint64_t v0, v1, v2;
+        memcpy(&v0, &src[i], sizeof(uint64_t));
+        memcpy(&v1, &src[SIF_CRC32C_BLOCK_SIZE + i], sizeof(uint64_t));
+        memcpy(&v2, &src[2u * SIF_CRC32C_BLOCK_SIZE + i], sizeof(uint64_t));
+        crc0 = SIF_CRC32C_STEP(crc0, v0);
+        crc1 = SIF_CRC32C_STEP(crc1, v1);
+        crc2 = SIF_CRC32C_STEP(crc2, v2);
+      }
+      crc0 = SIF_crc32cMultiply(shift_2, (uint32_t)crc0) ^ SIF_crc32cMultiply(shift_1, (uint32_t)crc1) ^ crc2;
+      src += 3u * SIF_CRC32C_BLOCK_SIZE;
+      size -= 3u * SIF_CRC32C_BLOCK_SIZE;
+    } while (size >= 3u * SIF_CRC32C_BLOCK_SIZE);
+  }
+  while (size >= sizeof(uint64_t)) {
+    uint64_t v;
+    memcpy(&v, src, sizeof(uint64_t));
+    crc0 = SIF_CRC32C_STEP(crc0, v);
+    src += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+  }
+  return SIF_crc32cSoftware((uint32_t)crc0, src, size);
+}
+#endif
+
+/* Extends crc, the CRC32C of some preceding data or 0 for none, over the next size bytes. */
+uint32_t SIF_crc32cExtend(uint32_t const crc, const void* const src, size_t const size) {
+  SIF_ASSERT(src != NULL);
+#ifdef SIF_CRC32C_HARDWARE
+  if (SIF_CRC32C_HARDWARE_AVAILABLE())
+    return ~SIF_crc32cHardware(~crc, (const uint8_t*)src, size);
+#endif
+  return ~SIF_crc32cSoftware(~crc, (const uint8_t*)src, size);
+}
+
+uint32_t SIF_crc32c(const void* const src, size_t const size) {
+  return SIF_crc32cExtend(0u, src, size);
+}
+
+/* The checksum of a slice covers its header fields that say how to decode it, i.e., the flags,
+   extended flags and height, that precede the checksum, and then its data. Only the size and the
+   checksum itself are left out; the size is validated against the end of slice marker. */
+uint32_t SIF_sliceChecksum(const uint8_t* const fields, size_t const fieldsSize, const uint8_t* const data, size_t const dataSize) {
+  return SIF_crc32cExtend(SIF_crc32c(fields, fieldsSize), data, dataSize);
+}
+
+bool SIF_reserveBuffer(SIF_buffer_t* const buffer, uint64_t const required) {
+  SIF_ASSERT(buffer != NULL);
+  if (SIF_LIKELY(required <= (uint64_t)buffer->capacity))
+    return true;
+  if ((!buffer->growable) || (required > SIZE_MAX))
+    return false;
+  /* grow geometrically so that the amortized cost of copying stays linear */
+  uint64_t capacity = (uint64_t)buffer->capacity + (buffer->capacity >> 1u);
+  if (capacity < required)
+    capacity = required;
+  if (capacity > SIZE_MAX)
+    capacity = SIZE_MAX;
+#ifdef SIF_REALLOC
+  uint8_t* const data = (uint8_t*)SIF_REALLOC(buffer->data, (size_t)capacity);
+  if (data == NULL)
+    return false;
+#else
+  uint8_t* const data = (uint8_t*)SIF_MALLOC((size_t)capacity);
+  if (data == NULL)
+    return false;
+  if (buffer->data != NULL) {
+    memcpy(data, buffer->data, buffer->size);
+    SIF_FREE(buffer->data);
+  }
+#endif
+  buffer->data = data;
+  buffer->capacity = (size_t)capacity;
+  return true;
+}
+
+void* SIF_shrinkBuffer(SIF_buffer_t* const buffer) {
+  SIF_ASSERT(buffer != NULL);
+  if ((buffer->size == buffer->capacity) || (buffer->size == 0u))
+    return buffer->data;
+#ifdef SIF_REALLOC
+  uint8_t* const data = (uint8_t*)SIF_REALLOC(buffer->data, buffer->size);
+  if (data == NULL)
+    return buffer->data;
+#else
+  uint8_t* const data = (uint8_t*)SIF_MALLOC(buffer->size);
+  if (data == NULL)
+    return buffer->data;
+  memcpy(data, buffer->data, buffer->size);
+  SIF_FREE(buffer->data);
+#endif
+  buffer->data = data;
+  buffer->capacity = buffer->size;
+  return data;
+}
+
 size_t SIF_encodeRun(uint8_t* const dst, const uint8_t* const deltas, uint32_t* run, uint32_t* run0) {
   SIF_ASSERT(dst != NULL);
   SIF_ASSERT(deltas != NULL);
@@ -274,29 +621,153 @@ size_t SIF_encodeRun(uint8_t* const dst, const uint8_t* const deltas, uint32_t*
   return position;
 }
 
-SIF_INLINE uint64_t SIF_compressSliceBound(const SIF_content_descriptor_t* const slice) {
+SIF_FORCE_INLINE uint32_t SIF_zeroRunCost(uint32_t const length) {
+  uint32_t const remainder = length % (SIF_RUN_MINIMUM_LENGTH + 0xFFu);
+  return (length / (SIF_RUN_MINIMUM_LENGTH + 0xFFu)) * (SIF_RUN_MINIMUM_LENGTH + 1u) + ((remainder < SIF_RUN_MINIMUM_LENGTH) ? remainder : SIF_RUN_MINIMUM_LENGTH + 1u);
+}
+
+/* Exact size SIF_encodeRun would produce for a run of length deltas, of which the first
+   zeros are 0 and, if not all deltas are 0, the remaining ones take body bytes. */
+SIF_FORCE_INLINE uint32_t SIF_runCost(uint32_t const length, uint32_t const zeros, uint32_t const body) {
+  if ((zeros > 1u) && (zeros <= 32u))
+    return ((zeros + 7u) >> 3u) + ((length > zeros) ? 1u + (length - zeros > 0x10u) + body : 0u);
+  return 1u + (length > 0x10u) + SIF_zeroRunCost(zeros) + ((length > zeros) ? body : 0u);
+}
+
+/* Same contract as SIF_encodeRun, but instead of emitting the whole run greedily, finds the
+   cheapest way of splitting it into shorter runs and single-byte dictionary hits. hits[i]
+   holds the reduced offset opcode for deltas[i] if that pixel is in the dictionary, else 0.
+   Pixels in a run never update the dictionary, so the dictionary is the same for all of
+   them and any mix of both is decodable. */
+size_t SIF_encodeRunOptimal(uint8_t* const dst, const uint8_t* const deltas, const uint8_t* const hits, uint32_t* run, uint32_t* run0, SIF_optimal_parse_t* const parse) {
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(deltas != NULL);
+  SIF_ASSERT(hits != NULL);
+  SIF_ASSERT(run != NULL);
+  SIF_ASSERT(run0 != NULL);
+  SIF_ASSERT(parse != NULL);
+  SIF_ASSERT((*run > 0u) && (*run <= SIF_RUN_CACHE_SIZE));
+
+  uint32_t* const cost = parse->cost;
+  uint32_t* const body = parse->body;
+  uint16_t* const next_nonzero = parse->next_nonzero;
+  uint16_t* const from = parse->from;
+  uint32_t const n = *run;
+  uint16_t const literal = 0x8000u;
+
+  /* cost of coding [i, n) as one run, for any i, from the first nonzero delta onwards */
+  next_nonzero[n] = (uint16_t)n;
+  for (uint32_t i = n; i-- > 0u;) {
+    next_nonzero[i] = (deltas[i] > 0u) ? (uint16_t)i : next_nonzero[i + 1u];
+    if (deltas[i] > 0u) {
+      uint32_t const j = next_nonzero[i + 1u];
+      body[i] = 1u + SIF_zeroRunCost(j - i - 1u) + ((j < n) ? body[j] : 0u);
+    }
+  }
+
+  cost[0] = 0u;
+  for (uint32_t i = 1u; i <= n; i++)
+    cost[i] = UINT32_MAX;
+  for (uint32_t i = 0u; i < n; i++) {
+    SIF_ASSERT(cost[i] < UINT32_MAX);
+    if ((hits[i] > 0u) && (cost[i] + 1u < cost[i + 1u])) {
+      cost[i + 1u] = cost[i] + 1u;
+      from[i + 1u] = (uint16_t)(i | literal);
+    }
+    uint32_t const end = (n - i > SIF_OPTIMAL_PARSE_WINDOW) ? i + SIF_OPTIMAL_PARSE_WINDOW : n;
+    uint32_t zeros = 0u, closed = 0u, trailing = 0u;
+    for (uint32_t j = i; j < end; j++) {
+      if (zeros == j - i) {
+        if (deltas[j] == 0u)
+          zeros++;
+        else
+          closed = 1u;
+      }
+      else if (deltas[j] == 0u)
+        trailing++;
+      else {
+        closed += SIF_zeroRunCost(trailing) + 1u;
+        trailing = 0u;
+      }
+      uint32_t const c = cost[i] + SIF_runCost(j + 1u - i, zeros, closed + SIF_zeroRunCost(trailing));
+      if (c < cost[j + 1u]) {
+        cost[j + 1u] = c;
+        from[j + 1u] = (uint16_t)i;
+      }
+    }
+    if (end < n) {
+      uint32_t const j = next_nonzero[i];
+      uint32_t const c = cost[i] + SIF_runCost(n - i, j - i, (j < n) ? body[j] : 0u);
+      if (c < cost[n]) {
+        cost[n] = c;
+        from[n] = (uint16_t)i;
+      }
+    }
+  }
+
+  /* walk the chosen path backwards, then emit it in order */
+  uint16_t* const path = next_nonzero;
+  for (uint32_t j = n; j > 0u;) {
+    uint32_t const i = from[j] & ~literal;
+    path[i] = (uint16_t)(j | (from[j] & literal));
+    j = i;
+  }
+  size_t position = 0u;
+  for (uint32_t i = 0u; i < n;) {
+    uint32_t const j = path[i] & ~literal;
+    if ((path[i] & literal) > 0u)
+      dst[position++] = hits[i];
+    else {
+      uint32_t length = j - i, zeros = 0u;
+      while ((zeros < length) && (deltas[i + zeros] == 0u))
+        zeros++;
+      position += SIF_encodeRun(&dst[position], &deltas[i], &length, &zeros);
+    }
+    i = j;
+  }
+  SIF_ASSERT(position == cost[n]);
+  *run = 0u;
+  *run0 = 0u;
+  return position;
+}
+
+static SIF_INLINE uint64_t SIF_compressSliceBound(const SIF_content_descriptor_t* const slice) {
   SIF_ASSERT(slice != NULL);
   return ((uint64_t)slice->width) * ((uint64_t)slice->height) * ((uint64_t)slice->channels + 1u) + sizeof(SIF_end_of_slice_marker_t);
 }
 
-size_t SIF_compressSlice(const SIF_content_descriptor_t* const slice, void* const dst, size_t const dstCapacity, const void* const src, size_t const srcSize) {
+/* largest slice height, up to the remaining lines, whose compressed size bound still fits the 32-bit slice size */
+static SIF_INLINE ULEB128_t SIF_sliceHeight(const SIF_content_descriptor_t* const image, ULEB128_t const remaining_lines) {
+  SIF_ASSERT(image != NULL);
+  uint64_t const lines = ((uint64_t)UINT32_MAX - sizeof(SIF_end_of_slice_marker_t)) / (((uint64_t)image->width) * ((uint64_t)image->channels + 1u));
+  return (lines < (uint64_t)remaining_lines) ? (ULEB128_t)lines : remaining_lines;
+}
+
+static SIF_INLINE uint8_t SIF_extendedFlags(uint32_t const options) {
+  uint8_t extended_flags = (options & SIF_option_slice_checksum) ? SIF_EXTENDED_FLAGS_MASK_CHECKSUM : 0u;
+  if (options & SIF_option_dict_4way)
+    extended_flags |= 2u << SIF_EXTENDED_FLAGS_SHIFT_DICT_WAYS;
+  else if (options & SIF_option_dict_2way)
+    extended_flags |= 1u << SIF_EXTENDED_FLAGS_SHIFT_DICT_WAYS;
+  if (options & SIF_option_dict_large)
+    extended_flags |= SIF_EXTENDED_FLAGS_MASK_DICT_LARGE;
+  return extended_flags;
+}
+
+static SIF_INLINE size_t SIF_tileHeight(uint8_t const flags) {
+  return (1u << (SIF_TILE_HEIGHT_DEFAULT_EXPONENT + ((flags & SIF_FLAGS_MASK_TILE_HEIGHT) >> SIF_FLAGS_SHIFT_TILE_HEIGHT))) - 1u;
+}
+
+void SIF_initSliceParameters(SIF_slice_parameters_t* const parameters, const SIF_content_descriptor_t* const slice, uint8_t const extended_flags) {
+  SIF_ASSERT(parameters != NULL);
   SIF_ASSERT(slice != NULL);
   SIF_ASSERT((slice->width > 0u) && (slice->width <= SIF_MAX_DIMENSION));
   SIF_ASSERT((slice->height > 0u) && (slice->height <= SIF_MAX_DIMENSION));
   SIF_ASSERT(slice->channels == 3u);
-  SIF_ASSERT(SIF_compressSliceBound(slice) <= (uint64_t)dstCapacity);
-  SIF_ASSERT(dst != NULL);
-  SIF_ASSERT(src != NULL);
-  SIF_ASSERT(srcSize >= ((size_t)slice->width * slice->height * slice->channels));
-
-  uint8_t run_cache[SIF_RUN_CACHE_SIZE] = { 0 };
-  SIF_pixel_t dict[SIF_DICT_NUM_OF_BUCKETS * SIF_DICT_ITEMS_PER_BUCKET] = { 0 };
-  SIF_pixel_t sld_wnd[SIF_TILE_WIDTH * 2u] = { 0 };
-  const uint8_t* const src_ = (const uint8_t* const)src;
-  uint8_t* const dst_ = (uint8_t* const)dst;
-
-  size_t const predictor_id = (slice->flags & SIF_FLAGS_MASK_PREDICTOR_ID) >> SIF_FLAGS_SHIFT_PREDICTOR_ID;
-  SIF_pixel_t prediction = { 0 }, prev_pixel = { 0 }, pixel = { 0 }, range_8b, run_mask, range_20b, mask_20b;
+  parameters->slice = *slice;
+  parameters->predictor_id = (slice->flags & SIF_FLAGS_MASK_PREDICTOR_ID) >> SIF_FLAGS_SHIFT_PREDICTOR_ID;
+  SIF_pixel_t range_8b, run_mask;
+  range_8b.value = 0u;
   switch ((slice->flags & SIF_FLAGS_MASK_DELTA_BIAS) >> SIF_FLAGS_SHIFT_DELTA_BIAS) {
     case SIF_delta_red_bias:
     default: {
@@ -318,474 +789,1327 @@ size_t SIF_compressSlice(const SIF_content_descriptor_t* const slice, void* cons
       break;
     }
   }
-  range_20b.value = range_8b.value << 4u;
+  run_mask.value = 0u;
   run_mask.delta.r = (range_8b.delta.r << 1) - 1;
   run_mask.delta.g = (range_8b.delta.g << 1) - 1;
   run_mask.delta.b = (range_8b.delta.b << 1) - 1;
-  mask_20b.value = (run_mask.value << 4u) | (0x0F0F0Fu);
-  int const run_shift_g = 2 + (range_8b.delta.b > 2), run_shift_r = run_shift_g + 2 + (range_8b.delta.g > 2);
-  int const delta_20b_shift_g = run_shift_g + 4, delta_20b_shift_r = run_shift_r + 8;
+  parameters->range_8b = range_8b;
+  parameters->run_mask = run_mask;
+  parameters->range_20b.value = range_8b.value << 4u;
+  parameters->mask_20b.value = (run_mask.value << 4u) | (0x0F0F0Fu);
+  parameters->run_shift_g = 2 + (range_8b.delta.b > 2);
+  parameters->run_shift_r = parameters->run_shift_g + 2 + (range_8b.delta.g > 2);
+  parameters->delta_20b_shift_g = parameters->run_shift_g + 4;
+  parameters->delta_20b_shift_r = parameters->run_shift_r + 8;
+
+  parameters->use_contextual_dict = (slice->flags & SIF_FLAGS_MASK_CONTEXTUAL_DICT) >> SIF_FLAGS_SHIFT_CONTEXTUAL_DICT;
+  parameters->use_2d_prediction = (parameters->predictor_id != SIF_predictor_direct) && (((slice->flags & SIF_FLAGS_MASK_2D_PREDICTOR) >> SIF_FLAGS_SHIFT_2D_PREDICTOR) != 0u);
+
+  size_t const ways_exponent = (extended_flags & SIF_EXTENDED_FLAGS_MASK_DICT_WAYS) >> SIF_EXTENDED_FLAGS_SHIFT_DICT_WAYS;
+  SIF_ASSERT(ways_exponent <= SIF_DICT_MAX_WAYS_EXPONENT);
+  size_t const context_bits = (extended_flags & SIF_EXTENDED_FLAGS_MASK_DICT_LARGE) ? SIF_DICT_LARGE_CONTEXT_BIT_LENGTH : SIF_DICT_CONTEXT_BIT_LENGTH;
+  parameters->dict_ways = (size_t)1u << ways_exponent;
+  parameters->dict_set_mask = SIF_DICT_ITEMS_PER_BUCKET - parameters->dict_ways;
+  parameters->dict_context_shift = 9u - context_bits;
+  parameters->dict_size = (parameters->use_contextual_dict ? ((size_t)1u << context_bits) : 1u) * SIF_DICT_ITEMS_PER_BUCKET;
+
+  parameters->tile_height = SIF_tileHeight(slice->flags);
+  parameters->grid_width_in_tiles = (slice->width + (SIF_TILE_WIDTH - 1u)) / SIF_TILE_WIDTH;
+  parameters->grid_height_in_tiles = (slice->height + (parameters->tile_height - 1u)) / parameters->tile_height;
+  parameters->remaining_columns = slice->width - (parameters->grid_width_in_tiles - 1u) * SIF_TILE_WIDTH;
+  parameters->remaining_lines = slice->height - (parameters->grid_height_in_tiles - 1u) * parameters->tile_height;
+}
 
-  bool const use_contextual_dict = (slice->flags & SIF_FLAGS_MASK_CONTEXTUAL_DICT) >> SIF_FLAGS_SHIFT_CONTEXTUAL_DICT;
-  bool const use_2d_prediction = (predictor_id != SIF_predictor_direct) && (((slice->flags & SIF_FLAGS_MASK_2D_PREDICTOR) >> SIF_FLAGS_SHIFT_2D_PREDICTOR) != 0u);
+SIF_slice_encoder_t* SIF_createEncoder(void) {
+  return (SIF_slice_encoder_t*)SIF_MALLOC(sizeof(SIF_slice_encoder_t));
+}
 
-  size_t position = 0u;
-  uint32_t run = 0u, run0 = 0u, sld_offset = 0u;
-
-  size_t const SIF_tile_height = (1u << (SIF_TILE_HEIGHT_DEFAULT_EXPONENT + ((slice->flags & SIF_FLAGS_MASK_TILE_HEIGHT) << SIF_FLAGS_SHIFT_TILE_HEIGHT))) - 1u;
-  size_t const grid_width_in_tiles = (slice->width + (SIF_TILE_WIDTH - 1u)) / SIF_TILE_WIDTH;
-  size_t const grid_height_in_tiles = (slice->height + (SIF_tile_height - 1u)) / SIF_tile_height;
-  size_t const remaining_columns = slice->width - (grid_width_in_tiles - 1u) * SIF_TILE_WIDTH;
-  size_t const remaining_lines = slice->height - (grid_height_in_tiles - 1u) * SIF_tile_height;
-  size_t const channels = slice->channels;
-  size_t const stride = slice->width * channels;
-  size_t const tile_stride = SIF_tile_height * stride;
+void SIF_freeEncoder(SIF_slice_encoder_t* const encoder) {
+  SIF_FREE(encoder);
+}
+
+void SIF_initSliceEncoder(SIF_slice_encoder_t* const encoder, const SIF_content_descriptor_t* const slice, const SIF_buffer_t* const dst, uint32_t const options) {
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_initSliceParameters(&encoder->parameters, slice, SIF_extendedFlags(options));
+  encoder->options = options;
+  memset(encoder->run_cache, 0, sizeof(encoder->run_cache));
+  memset(encoder->dict, 0, encoder->parameters.dict_size * sizeof(SIF_pixel_t));
+  memset(encoder->sld_wnd, 0, sizeof(encoder->sld_wnd));
+  encoder->prev_pixel.value = 0u;
+  encoder->run = encoder->run0 = encoder->sld_offset = 0u;
+  encoder->base = dst->size;
+  encoder->position = 0u;
+  encoder->tile_y = 0u;
+}
+
+/* Encodes the next tile row of the slice, whose first line starts at src, and returns the
+   number of lines consumed, or 0 if the output buffer could not be grown. Space is reserved
+   one tile row at a time, so a growable buffer only ever holds the compressed size plus a
+   single tile row's worst case. */
+size_t SIF_compressTileRow(SIF_slice_encoder_t* const encoder, SIF_buffer_t* const dst, const void* const src, size_t const stride) {
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(src != NULL);
+  const SIF_slice_parameters_t* const parameters = &encoder->parameters;
+  SIF_ASSERT(encoder->tile_y < parameters->grid_height_in_tiles);
+  SIF_ASSERT(stride >= (size_t)parameters->slice.width * parameters->slice.channels);
+
+  uint8_t* const run_cache = encoder->run_cache;
+  uint8_t* const run_hits = encoder->run_hits;
+  SIF_pixel_t* const dict = encoder->dict;
+  SIF_pixel_t* const sld_wnd = encoder->sld_wnd;
+  const uint8_t* const src_ = (const uint8_t*)src;
+
+  size_t const predictor_id = parameters->predictor_id;
+  SIF_pixel_t const range_8b = parameters->range_8b, run_mask = parameters->run_mask, range_20b = parameters->range_20b, mask_20b = parameters->mask_20b;
+  int const run_shift_g = parameters->run_shift_g, run_shift_r = parameters->run_shift_r;
+  int const delta_20b_shift_g = parameters->delta_20b_shift_g, delta_20b_shift_r = parameters->delta_20b_shift_r;
+  bool const use_contextual_dict = parameters->use_contextual_dict;
+  bool const use_2d_prediction = parameters->use_2d_prediction;
+  size_t const dict_ways = parameters->dict_ways, dict_set_mask = parameters->dict_set_mask, dict_context_shift = parameters->dict_context_shift;
+  bool const use_optimal_parse = (encoder->options & SIF_option_optimal_parse) != 0u;
+
+  SIF_pixel_t prediction, prev_pixel = encoder->prev_pixel, pixel;
+  prediction.value = pixel.value = 0u;
+  size_t position = encoder->position;
+  uint32_t run = encoder->run, run0 = encoder->run0, sld_offset = encoder->sld_offset;
+
+  size_t const tile_y = encoder->tile_y++;
+  size_t const grid_width_in_tiles = parameters->grid_width_in_tiles;
+  size_t const remaining_columns = parameters->remaining_columns;
+  size_t const channels = parameters->slice.channels;
   size_t const tile_inner_stride = SIF_TILE_WIDTH * channels;
-  size_t const last_pixel = (slice->width * slice->height - ((remaining_lines & 1u) ? 1u : remaining_columns)) * channels;
-
-  for (size_t tile_y = 0u, tile_initial_line = 0u; tile_y < grid_height_in_tiles; tile_y++, tile_initial_line += tile_stride) {
-    size_t const pixels_v = (tile_y < grid_height_in_tiles - 1u) ? SIF_tile_height : remaining_lines;
-    for (size_t i = 0u; i < grid_width_in_tiles; i++) {
-      size_t const tile_x = (tile_y & 1u) ? (grid_width_in_tiles - 1u) - i : i;
-      size_t const pixels_h = (tile_x < grid_width_in_tiles - 1u) ? SIF_TILE_WIDTH : remaining_columns;
-      size_t const tile_initial_offset = tile_initial_line + (tile_x * tile_inner_stride);
-      bool const tile_x_odd = (tile_x & 1u);
-      for (size_t y = 0u; y < pixels_v; y++) {
-        size_t const y_ = (tile_x_odd) ? pixels_v - 1u - y : y;
-        size_t const offset = tile_initial_offset + (y_ * stride);
-        bool const right_to_left = ((tile_y ^ y_) & 1u);
-        for (size_t x = 0u; x < pixels_h; x++) {
-          size_t const x_ = (right_to_left) ? pixels_h - 1u - x : x;
-          size_t const pixel_pos = offset + (x_ * channels);
-
-          pixel.rgba.r = src_[pixel_pos + 0u];
-          pixel.rgba.g = src_[pixel_pos + 1u];
-          pixel.rgba.b = src_[pixel_pos + 2u];
-
-          prediction = prev_pixel;
-          switch (predictor_id) {
-            case SIF_predictor_direct:
-            default: {
-              break;
-            }
-            case SIF_predictor_decorrelate_from_red: {
-              if (use_2d_prediction && (y > 0))
-                prediction.rgba.r = (prediction.rgba.r * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.r) >> 3u;
-              int8_t const delta = pixel.rgba.r - prediction.rgba.r;
-              prediction.rgba.g += delta;
-              prediction.rgba.b += delta;
-              break;
-            }
-            case SIF_predictor_decorrelate_from_green: {
-              if (use_2d_prediction && (y > 0))
-                prediction.rgba.g = (prediction.rgba.g * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.g) >> 3u;
-              int8_t const delta = pixel.rgba.g - prediction.rgba.g;
-              prediction.rgba.r += delta;
-              prediction.rgba.b += delta;
-              break;
-            }
-            case SIF_predictor_decorrelate_from_blue: {
-              if (use_2d_prediction && (y > 0))
-                prediction.rgba.b = (prediction.rgba.b * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.b) >> 3u;
-              int8_t const delta = pixel.rgba.b - prediction.rgba.b;
-              prediction.rgba.r += delta;
-              prediction.rgba.g += delta;
-              break;
-            }
+  size_t const pixels_v = (tile_y < parameters->grid_height_in_tiles - 1u) ? parameters->tile_height : parameters->remaining_lines;
+  size_t const last_pixel = (tile_y < parameters->grid_height_in_tiles - 1u) ? SIZE_MAX : (pixels_v - 1u) * stride + (parameters->slice.width - ((parameters->remaining_lines & 1u) ? 1u : remaining_columns)) * channels;
+
+  /* pending run and every pixel of this tile row can take at most (channels + 1) bytes each */
+  dst->size = encoder->base + position;
+  if (SIF_UNLIKELY(!SIF_reserveBuffer(dst, (uint64_t)dst->size + ((uint64_t)run + (uint64_t)pixels_v * parameters->slice.width) * (channels + 1u) + sizeof(SIF_end_of_slice_marker_t))))
+    return 0u;
+  uint8_t* const dst_ = &dst->data[encoder->base];
+
+#define SIF_FLUSH_RUN \
+  position += (use_optimal_parse) ? SIF_encodeRunOptimal(&dst_[position], &run_cache[0u], &run_hits[0u], &run, &run0, &encoder->parse) : SIF_encodeRun(&dst_[position], &run_cache[0u], &run, &run0)
+
+  for (size_t i = 0u; i < grid_width_in_tiles; i++) {
+    size_t const tile_x = (tile_y & 1u) ? (grid_width_in_tiles - 1u) - i : i;
+    size_t const pixels_h = (tile_x < grid_width_in_tiles - 1u) ? SIF_TILE_WIDTH : remaining_columns;
+    size_t const tile_initial_offset = tile_x * tile_inner_stride;
+    bool const tile_x_odd = (tile_x & 1u);
+    for (size_t y = 0u; y < pixels_v; y++) {
+      size_t const y_ = (tile_x_odd) ? pixels_v - 1u - y : y;
+      size_t const offset = tile_initial_offset + (y_ * stride);
+      bool const right_to_left = ((tile_y ^ y_) & 1u);
+      for (size_t x = 0u; x < pixels_h; x++) {
+        size_t const x_ = (right_to_left) ? pixels_h - 1u - x : x;
+        size_t const pixel_pos = offset + (x_ * channels);
+
+        pixel.rgba.r = src_[pixel_pos + 0u];
+        pixel.rgba.g = src_[pixel_pos + 1u];
+        pixel.rgba.b = src_[pixel_pos + 2u];
+
+        prediction = prev_pixel;
+        switch (predictor_id) {
+          case SIF_predictor_direct:
+          default: {
+            break;
           }
-          prediction.delta.r = pixel.rgba.r - prediction.rgba.r;
-          prediction.delta.g = pixel.rgba.g - prediction.rgba.g;
-          prediction.delta.b = pixel.rgba.b - prediction.rgba.b;
-
-          int const similar = SIF_checkRange(prediction.delta.r, range_8b.delta.r) && SIF_checkRange(prediction.delta.g, range_8b.delta.g) && SIF_checkRange(prediction.delta.b, range_8b.delta.b);
-          if (similar) {
-            uint8_t const delta = ((prediction.delta.r & run_mask.delta.r) << run_shift_r) | ((prediction.delta.g & run_mask.delta.g) << run_shift_g) | (prediction.delta.b & run_mask.delta.b);
-            if ((run == run0) && (delta == 0u))
-              run0++;
-            run_cache[run++] = delta;
-            if (SIF_UNLIKELY((run == SIF_RUN_CACHE_SIZE) || (pixel_pos == last_pixel)))
-              position += SIF_encodeRun(&dst_[position], &run_cache[0u], &run, &run0);
+          case SIF_predictor_decorrelate_from_red: {
+            if (use_2d_prediction && (y > 0))
+              prediction.rgba.r = (prediction.rgba.r * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.r) >> 3u;
+            int8_t const delta = pixel.rgba.r - prediction.rgba.r;
+            prediction.rgba.g += delta;
+            prediction.rgba.b += delta;
+            break;
           }
-          else {
-            if (run > 0u)
-              position += SIF_encodeRun(&dst_[position], &run_cache[0u], &run, &run0);
-            size_t offset = (size_t)SIF_pixelHash(pixel);
+          case SIF_predictor_decorrelate_from_green: {
+            if (use_2d_prediction && (y > 0))
+              prediction.rgba.g = (prediction.rgba.g * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.g) >> 3u;
+            int8_t const delta = pixel.rgba.g - prediction.rgba.g;
+            prediction.rgba.r += delta;
+            prediction.rgba.b += delta;
+            break;
+          }
+          case SIF_predictor_decorrelate_from_blue: {
+            if (use_2d_prediction && (y > 0))
+              prediction.rgba.b = (prediction.rgba.b * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.b) >> 3u;
+            int8_t const delta = pixel.rgba.b - prediction.rgba.b;
+            prediction.rgba.r += delta;
+            prediction.rgba.g += delta;
+            break;
+          }
+        }
+        prediction.delta.r = pixel.rgba.r - prediction.rgba.r;
+        prediction.delta.g = pixel.rgba.g - prediction.rgba.g;
+        prediction.delta.b = pixel.rgba.b - prediction.rgba.b;
+
+        int const similar = SIF_checkRange(prediction.delta.r, range_8b.delta.r) && SIF_checkRange(prediction.delta.g, range_8b.delta.g) && SIF_checkRange(prediction.delta.b, range_8b.delta.b);
+        if (similar) {
+          uint8_t const delta = ((prediction.delta.r & run_mask.delta.r) << run_shift_r) | ((prediction.delta.g & run_mask.delta.g) << run_shift_g) | (prediction.delta.b & run_mask.delta.b);
+          if ((run == run0) && (delta == 0u))
+            run0++;
+          if (use_optimal_parse) {
+            size_t offset = (size_t)SIF_pixelHash(pixel) & dict_set_mask;
             if (use_contextual_dict)
-              offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> (9u - SIF_DICT_CONTEXT_BIT_LENGTH)) << SIF_REDUCED_OFFSET_BIT_LENGTH;
-            SIF_ASSERT(offset < sizeof(dict) / sizeof(SIF_pixel_t));
-            if (dict[offset].value == pixel.value)
-              dst_[position++] = SIF_opcode_reduced_offset | (offset & (SIF_DICT_ITEMS_PER_BUCKET - 1u));
+              offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> dict_context_shift) << SIF_REDUCED_OFFSET_BIT_LENGTH;
+            size_t const way = SIF_dictFind(&dict[offset], pixel, dict_ways);
+            run_hits[run] = (way < dict_ways) ? (uint8_t)(SIF_opcode_reduced_offset | ((offset + way) & (SIF_DICT_ITEMS_PER_BUCKET - 1u))) : 0u;
+          }
+          run_cache[run++] = delta;
+          if (SIF_UNLIKELY((run == SIF_RUN_CACHE_SIZE) || (pixel_pos == last_pixel)))
+            SIF_FLUSH_RUN;
+        }
+        else {
+          if (run > 0u)
+            SIF_FLUSH_RUN;
+          size_t offset = (size_t)SIF_pixelHash(pixel) & dict_set_mask;
+          if (use_contextual_dict)
+            offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> dict_context_shift) << SIF_REDUCED_OFFSET_BIT_LENGTH;
+          SIF_ASSERT(offset + dict_ways <= parameters->dict_size);
+          size_t const way = SIF_dictFind(&dict[offset], pixel, dict_ways);
+          if (way < dict_ways)
+            dst_[position++] = SIF_opcode_reduced_offset | ((offset + way) & (SIF_DICT_ITEMS_PER_BUCKET - 1u));
+          else {
+            SIF_dictInsert(&dict[offset], pixel, dict_ways);
+            if (SIF_checkRange(prediction.delta.r, 16) && SIF_checkRange(prediction.delta.g, 16) && SIF_checkRange(prediction.delta.b, 16)) {
+              uint32_t const value = (SIF_opcode_delta_15b << 8u) | ((prediction.delta.r & 0x1Fu) << 10u) | ((prediction.delta.g & 0x1Fu) << 5u) | (prediction.delta.b & 0x1Fu);
+              dst_[position++] = (uint8_t)(value >> 8u);
+              dst_[position++] = (uint8_t)(value);
+            }
+            else if (
+              SIF_checkRange(prediction.delta.r, range_20b.delta.r) &&
+              SIF_checkRange(prediction.delta.g, range_20b.delta.g) &&
+              SIF_checkRange(prediction.delta.b, range_20b.delta.b) &&
+              (((prediction.delta.r != 0) + (prediction.delta.g != 0) + (prediction.delta.b != 0)) > 1)
+            ) {
+              uint32_t const value = (SIF_opcode_delta_20b << 16u) | ((prediction.delta.r & mask_20b.delta.r) << delta_20b_shift_r) | ((prediction.delta.g & mask_20b.delta.g) << delta_20b_shift_g) | (prediction.delta.b & mask_20b.delta.b);
+              dst_[position++] = (uint8_t)(value >> 16u);
+              dst_[position++] = (uint8_t)(value >>  8u);
+              dst_[position++] = (uint8_t)(value);
+            }
             else {
-              dict[offset] = pixel;
-              if (SIF_checkRange(prediction.delta.r, 16) && SIF_checkRange(prediction.delta.g, 16) && SIF_checkRange(prediction.delta.b, 16)) {
-                uint32_t const value = (SIF_opcode_delta_15b << 8u) | ((prediction.delta.r & 0x1Fu) << 10u) | ((prediction.delta.g & 0x1Fu) << 5u) | (prediction.delta.b & 0x1Fu);
-                dst_[position++] = (uint8_t)(value >> 8u);
-                dst_[position++] = (uint8_t)(value);
-              }
-              else if (
-                SIF_checkRange(prediction.delta.r, range_20b.delta.r) &&
-                SIF_checkRange(prediction.delta.g, range_20b.delta.g) &&
-                SIF_checkRange(prediction.delta.b, range_20b.delta.b) &&
-                (((prediction.delta.r != 0) + (prediction.delta.g != 0) + (prediction.delta.b != 0)) > 1)
-              ) {
-                uint32_t const value = (SIF_opcode_delta_20b << 16u) | ((prediction.delta.r & mask_20b.delta.r) << delta_20b_shift_r) | ((prediction.delta.g & mask_20b.delta.g) << delta_20b_shift_g) | (prediction.delta.b & mask_20b.delta.b);
-                dst_[position++] = (uint8_t)(value >> 16u);
-                dst_[position++] = (uint8_t)(value >>  8u);
-                dst_[position++] = (uint8_t)(value);
-              }
-              else {
-                uint8_t* const B = &dst_[position++], C = SIF_opcode_3chn_mask_delta_8bpc;
-                if (prediction.delta.r != 0) { dst_[position++] = (uint8_t)prediction.delta.r; C |= 0x04u; }
-                if (prediction.delta.g != 0) { dst_[position++] = (uint8_t)prediction.delta.g; C |= 0x02u; }
-                if (prediction.delta.b != 0) { dst_[position++] = (uint8_t)prediction.delta.b; C |= 0x01u; }
-                SIF_ASSERT((C & 0x07u) > 0u);
-                *B = C;
-              }
+              uint8_t* const B = &dst_[position++], C = SIF_opcode_3chn_mask_delta_8bpc;
+              if (prediction.delta.r != 0) { dst_[position++] = (uint8_t)prediction.delta.r; C |= 0x04u; }
+              if (prediction.delta.g != 0) { dst_[position++] = (uint8_t)prediction.delta.g; C |= 0x02u; }
+              if (prediction.delta.b != 0) { dst_[position++] = (uint8_t)prediction.delta.b; C |= 0x01u; }
+              SIF_ASSERT((C & 0x07u) > 0u);
+              *B = C;
             }
           }
-          prev_pixel = pixel;
-          if (use_2d_prediction)
-            sld_wnd[sld_offset++ & SIF_SLD_WND_MASK] = pixel;
         }
+        prev_pixel = pixel;
+        if (use_2d_prediction)
+          sld_wnd[sld_offset++ & SIF_SLD_WND_MASK] = pixel;
       }
     }
   }
-  if (run > 0)
-    position += SIF_encodeRun(&dst_[position], &run_cache[0u], &run, &run0);
+#undef SIF_FLUSH_RUN
+  encoder->prev_pixel = prev_pixel;
+  encoder->position = position;
+  encoder->run = run;
+  encoder->run0 = run0;
+  encoder->sld_offset = sld_offset;
+  dst->size = encoder->base + position;
+  return pixels_v;
+}
+
+/* Flushes any pending run and terminates the slice, returning its size. */
+size_t SIF_finishSlice(SIF_slice_encoder_t* const encoder, SIF_buffer_t* const dst) {
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(encoder->tile_y == encoder->parameters.grid_height_in_tiles);
+  SIF_ASSERT(dst->size == encoder->base + encoder->position);
+  uint8_t* const dst_ = &dst->data[encoder->base];
+  size_t position = encoder->position;
+  if (encoder->run > 0u) {
+    if (encoder->options & SIF_option_optimal_parse)
+      position += SIF_encodeRunOptimal(&dst_[position], &encoder->run_cache[0u], &encoder->run_hits[0u], &encoder->run, &encoder->run0, &encoder->parse);
+    else
+      position += SIF_encodeRun(&dst_[position], &encoder->run_cache[0u], &encoder->run, &encoder->run0);
+  }
   *((SIF_end_of_slice_marker_t*)&dst_[position]) = SIF_END_OF_SLICE_MARKER;
-  return position += sizeof(SIF_end_of_slice_marker_t);
+  position += sizeof(SIF_end_of_slice_marker_t);
+  encoder->position = position;
+  dst->size = encoder->base + position;
+  return position;
 }
 
-size_t SIF_decompressSlice(const SIF_content_descriptor_t* const slice, void* const dst, size_t const dstCapacity, const void* const src, size_t const srcSize) {
+/* Encodes a whole slice, whose lines are stride bytes apart, at the end of the buffer, with
+   encoder state that the caller keeps off the stack as it is tens of KB. Returns the slice size,
+   or 0 if the buffer could not be grown. */
+size_t SIF_compressSliceToBuffer(const SIF_content_descriptor_t* const slice, SIF_buffer_t* const dst, const void* const src, size_t const srcSize, size_t const stride, uint32_t const options, SIF_slice_encoder_t* const encoder) {
   SIF_ASSERT(slice != NULL);
-  SIF_ASSERT((slice->width > 0u) && (slice->width <= SIF_MAX_DIMENSION));
-  SIF_ASSERT((slice->height > 0u) && (slice->height <= SIF_MAX_DIMENSION));
-  SIF_ASSERT(slice->channels == 3u);
   SIF_ASSERT(dst != NULL);
   SIF_ASSERT(src != NULL);
-  SIF_ASSERT(dstCapacity >= ((size_t)slice->width * slice->height * slice->channels));
-  SIF_ASSERT(srcSize > sizeof(SIF_end_of_slice_marker_t));
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(stride >= (size_t)slice->width * slice->channels);
+  SIF_ASSERT(srcSize >= (slice->height - 1u) * stride + (size_t)slice->width * slice->channels);
+  (void)srcSize;
+
+  SIF_initSliceEncoder(encoder, slice, dst, options);
+  const uint8_t* const src_ = (const uint8_t*)src;
+  for (size_t line = 0u; line < slice->height;) {
+    size_t const lines = SIF_compressTileRow(encoder, dst, &src_[line * stride], stride);
+    if (lines == 0u)
+      return 0u;
+    line += lines;
+  }
+  return SIF_finishSlice(encoder, dst);
+}
+
+size_t SIF_compressSlice(const SIF_content_descriptor_t* const slice, void* const dst, size_t const dstCapacity, const void* const src, size_t const srcSize) {
+  SIF_ASSERT(slice != NULL);
+  SIF_ASSERT(SIF_compressSliceBound(slice) <= (uint64_t)dstCapacity);
+  SIF_ASSERT(dst != NULL);
+  SIF_buffer_t buffer = { (uint8_t*)dst, 0u, dstCapacity, false };
+  SIF_slice_encoder_t* const encoder = SIF_createEncoder();
+  size_t const size = (encoder != NULL) ? SIF_compressSliceToBuffer(slice, &buffer, src, srcSize, (size_t)slice->width * slice->channels, SIF_option_none, encoder) : 0u;
+  SIF_freeEncoder(encoder);
+  return size;
+}
 
-  uint8_t run_cache[SIF_RUN_CACHE_SIZE] = { 0 };
-  SIF_pixel_t dict[SIF_DICT_NUM_OF_BUCKETS * SIF_DICT_ITEMS_PER_BUCKET] = { 0 };
-  SIF_pixel_t sld_wnd[SIF_TILE_WIDTH * 2u] = { 0 };
-  const uint8_t* const src_ = (const uint8_t* const)src;
-  uint8_t* const dst_ = (uint8_t* const)dst;
+SIF_slice_decoder_t* SIF_createDecoder(void) {
+  return (SIF_slice_decoder_t*)SIF_MALLOC(sizeof(SIF_slice_decoder_t));
+}
+
+void SIF_freeDecoder(SIF_slice_decoder_t* const decoder) {
+  SIF_FREE(decoder);
+}
+
+void SIF_initSliceDecoder(SIF_slice_decoder_t* const decoder, const SIF_content_descriptor_t* const slice, uint8_t const extended_flags) {
+  SIF_ASSERT(decoder != NULL);
+  SIF_initSliceParameters(&decoder->parameters, slice, extended_flags);
+  memset(decoder->run_cache, 0, sizeof(decoder->run_cache));
+  memset(decoder->dict, 0, decoder->parameters.dict_size * sizeof(SIF_pixel_t));
+  memset(decoder->sld_wnd, 0, sizeof(decoder->sld_wnd));
+  decoder->prev_pixel.value = 0u;
+  decoder->run = decoder->run0 = decoder->sld_offset = 0u;
+  decoder->cache_index = 0u;
+  decoder->position = 0u;
+  decoder->tile_y = 0u;
+}
+
+/* Decodes the next tile row of the slice into the lines starting at dst and returns the number of lines produced. */
+size_t SIF_decompressTileRow(SIF_slice_decoder_t* const decoder, void* const dst, size_t const stride, const void* const src, size_t const srcSize) {
+  SIF_ASSERT(decoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(srcSize > sizeof(SIF_end_of_slice_marker_t));
+  const SIF_slice_parameters_t* const parameters = &decoder->parameters;
+  SIF_ASSERT(decoder->tile_y < parameters->grid_height_in_tiles);
+  SIF_ASSERT(stride >= (size_t)parameters->slice.width * parameters->slice.channels);
+
+  uint8_t* const run_cache = decoder->run_cache;
+  SIF_pixel_t* const dict = decoder->dict;
+  SIF_pixel_t* const sld_wnd = decoder->sld_wnd;
+  const uint8_t* const src_ = (const uint8_t*)src;
+  uint8_t* const dst_ = (uint8_t*)dst;
   size_t const srcEnd = srcSize - sizeof(SIF_end_of_slice_marker_t);
 
-  size_t const predictor_id = (slice->flags & SIF_FLAGS_MASK_PREDICTOR_ID) >> SIF_FLAGS_SHIFT_PREDICTOR_ID;
-  SIF_pixel_t prediction = { 0 }, prev_pixel = { 0 }, pixel = { 0 }, range_8b, run_mask, mask_20b;
-  switch ((slice->flags & SIF_FLAGS_MASK_DELTA_BIAS) >> SIF_FLAGS_SHIFT_DELTA_BIAS) {
-    case SIF_delta_red_bias:
-    default: {
-      range_8b.delta.r = 2;
-      range_8b.delta.g = 4;
-      range_8b.delta.b = 4;
-      break;
-    }
-    case SIF_delta_green_bias: {
-      range_8b.delta.r = 4;
-      range_8b.delta.g = 2;
-      range_8b.delta.b = 4;
-      break;
-    }
-    case SIF_delta_blue_bias: {
-      range_8b.delta.r = 4;
-      range_8b.delta.g = 4;
-      range_8b.delta.b = 2;
-      break;
-    }
-  }
-  run_mask.delta.r = (range_8b.delta.r << 1) - 1;
-  run_mask.delta.g = (range_8b.delta.g << 1) - 1;
-  run_mask.delta.b = (range_8b.delta.b << 1) - 1;
-  mask_20b.value = (run_mask.value << 4u) | (0x0F0F0Fu);
-  int const run_shift_g = 2 + (range_8b.delta.b > 2), run_shift_r = run_shift_g + 2 + (range_8b.delta.g > 2);
-  int const delta_20b_shift_g = run_shift_g + 4, delta_20b_shift_r = run_shift_r + 8;
-
-  bool const use_contextual_dict = (slice->flags & SIF_FLAGS_MASK_CONTEXTUAL_DICT) >> SIF_FLAGS_SHIFT_CONTEXTUAL_DICT;
-  bool const use_2d_prediction = (predictor_id != SIF_predictor_direct) && (((slice->flags & SIF_FLAGS_MASK_2D_PREDICTOR) >> SIF_FLAGS_SHIFT_2D_PREDICTOR) != 0u);
-
-  size_t position = 0u, cache_index = 0u;
-  uint32_t run = 0u, run0 = 0u, sld_offset = 0u;
-
-  size_t const SIF_tile_height = (1u << (SIF_TILE_HEIGHT_DEFAULT_EXPONENT + ((slice->flags & SIF_FLAGS_MASK_TILE_HEIGHT) << SIF_FLAGS_SHIFT_TILE_HEIGHT))) - 1u;
-  size_t const grid_width_in_tiles = (slice->width + (SIF_TILE_WIDTH - 1u)) / SIF_TILE_WIDTH;
-  size_t const grid_height_in_tiles = (slice->height + (SIF_tile_height - 1u)) / SIF_tile_height;
-  size_t const remaining_columns = slice->width - (grid_width_in_tiles - 1u) * SIF_TILE_WIDTH;
-  size_t const remaining_lines = slice->height - (grid_height_in_tiles - 1u) * SIF_tile_height;
-  size_t const channels = slice->channels;
-  size_t const stride = slice->width * channels;
-  size_t const tile_stride = SIF_tile_height * stride;
+  size_t const predictor_id = parameters->predictor_id;
+  SIF_pixel_t const run_mask = parameters->run_mask, mask_20b = parameters->mask_20b;
+  int const run_shift_g = parameters->run_shift_g, run_shift_r = parameters->run_shift_r;
+  int const delta_20b_shift_g = parameters->delta_20b_shift_g, delta_20b_shift_r = parameters->delta_20b_shift_r;
+  bool const use_contextual_dict = parameters->use_contextual_dict;
+  bool const use_2d_prediction = parameters->use_2d_prediction;
+  size_t const dict_ways = parameters->dict_ways, dict_set_mask = parameters->dict_set_mask, dict_context_shift = parameters->dict_context_shift;
+
+  SIF_pixel_t prediction, prev_pixel = decoder->prev_pixel, pixel;
+  prediction.value = pixel.value = 0u;
+  size_t position = decoder->position, cache_index = decoder->cache_index;
+  uint32_t run = decoder->run, run0 = decoder->run0, sld_offset = decoder->sld_offset;
+
+  size_t const tile_y = decoder->tile_y++;
+  size_t const grid_width_in_tiles = parameters->grid_width_in_tiles;
+  size_t const remaining_columns = parameters->remaining_columns;
+  size_t const channels = parameters->slice.channels;
   size_t const tile_inner_stride = SIF_TILE_WIDTH * channels;
-
-  for (size_t tile_y = 0u, tile_initial_line = 0u; tile_y < grid_height_in_tiles; tile_y++, tile_initial_line += tile_stride) {
-    size_t const pixels_v = (tile_y < grid_height_in_tiles - 1u) ? SIF_tile_height : remaining_lines;
-    for (size_t i = 0u; i < grid_width_in_tiles; i++) {
-      size_t const tile_x = (tile_y & 1u) ? (grid_width_in_tiles - 1u) - i : i;
-      size_t const pixels_h = (tile_x < grid_width_in_tiles - 1u) ? SIF_TILE_WIDTH : remaining_columns;
-      size_t const tile_initial_offset = tile_initial_line + (tile_x * tile_inner_stride);
-      bool const tile_x_odd = (tile_x & 1u);
-      for (size_t y = 0u; y < pixels_v; y++) {
-        size_t const y_ = (tile_x_odd) ? pixels_v - 1u - y : y;
-        size_t const offset = tile_initial_offset + (y_ * stride);
-        bool const right_to_left = ((tile_y ^ y_) & 1u);
-        for (size_t x = 0u; x < pixels_h; x++) {
-          size_t const x_ = (right_to_left) ? pixels_h - 1u - x : x;
-          size_t const pixel_pos = offset + (x_ * channels);
-
-          bool must_add_to_dict = false;
-          if (run0 > 0) {
-            pixel.value = 0u;
-            run0--;
-          }
-          else if (run > 0) {
-            uint8_t const delta = run_cache[cache_index++];
-            pixel.delta.r = (((int8_t)(delta & (run_mask.delta.r << run_shift_r))) >> run_shift_r);
-            pixel.delta.g = (((int8_t)(((delta >> run_shift_g) & run_mask.delta.g) << (8 - run_shift_r + run_shift_g))) >> (8 - run_shift_r + run_shift_g));
-            pixel.delta.b = (((int8_t)((delta & run_mask.delta.b) << (8 - run_shift_g))) >> (8 - run_shift_g));
-            run--;
-          }
-          else if (position < srcEnd) {
-            uint8_t op = src_[position++];
-            if ((op & SIF_OPCODE_MASK(3)) == SIF_opcode_run_delta_8b) {
-              run = op & (~SIF_OPCODE_MASK(3));
-              if (run > 0xFu) {
-                run &= 0xFu;
-                if (position < srcEnd)
-                  run |= src_[position++] << 4u;
-              }
-              run++;
-              SIF_ASSERT(run <= SIF_RUN_CACHE_SIZE);
-              cache_index = 0u;
-              while ((position < srcEnd) && (cache_index < run)) {
-                uint8_t const B = src_[position++];
-                run_cache[cache_index++] = B;
-                run0 = (B > 0u) ? 0u : run0 + 1u;
-                if ((run0 == SIF_RUN_MINIMUM_LENGTH) && (position < srcEnd)) {
-                  run0 = src_[position++];
-                  while ((cache_index < run) && (run0 > 0u)) {
-                    run_cache[cache_index++] = 0u;
-                    run0--;
-                  }
-                }
-              }
-              SIF_ASSERT(cache_index == run);
-              x--;
-              cache_index = 0u;
-              run0 = 0u;
-              continue;
-            }
-            else if ((op & SIF_OPCODE_MASK(5)) == SIF_opcode_3chn_run_delta0) {
-              run0 = op ^ SIF_opcode_3chn_run_delta0;
-              pixel.value = 0;
-            }
-            else if ((op & SIF_OPCODE_MASK(2)) == SIF_opcode_reduced_offset) {
-              size_t offset = (size_t)(op ^ SIF_opcode_reduced_offset);
-              if (use_contextual_dict)
-                offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> (9u - SIF_DICT_CONTEXT_BIT_LENGTH)) << SIF_REDUCED_OFFSET_BIT_LENGTH;
-              pixel = dict[offset];
-              goto output_pixel;
+  size_t const pixels_v = (tile_y < parameters->grid_height_in_tiles - 1u) ? parameters->tile_height : parameters->remaining_lines;
+
+  for (size_t i = 0u; i < grid_width_in_tiles; i++) {
+    size_t const tile_x = (tile_y & 1u) ? (grid_width_in_tiles - 1u) - i : i;
+    size_t const pixels_h = (tile_x < grid_width_in_tiles - 1u) ? SIF_TILE_WIDTH : remaining_columns;
+    size_t const tile_initial_offset = tile_x * tile_inner_stride;
+    bool const tile_x_odd = (tile_x & 1u);
+    for (size_t y = 0u; y < pixels_v; y++) {
+      size_t const y_ = (tile_x_odd) ? pixels_v - 1u - y : y;
+      size_t const offset = tile_initial_offset + (y_ * stride);
+      bool const right_to_left = ((tile_y ^ y_) & 1u);
+      for (size_t x = 0u; x < pixels_h; x++) {
+        size_t const x_ = (right_to_left) ? pixels_h - 1u - x : x;
+        size_t const pixel_pos = offset + (x_ * channels);
+
+        bool must_add_to_dict = false;
+        if (run0 > 0) {
+          pixel.value = 0u;
+          run0--;
+        }
+        else if (run > 0) {
+          uint8_t const delta = run_cache[cache_index++];
+          pixel.delta.r = (((int8_t)(delta & (run_mask.delta.r << run_shift_r))) >> run_shift_r);
+          pixel.delta.g = (((int8_t)(((delta >> run_shift_g) & run_mask.delta.g) << (8 - run_shift_r + run_shift_g))) >> (8 - run_shift_r + run_shift_g));
+          pixel.delta.b = (((int8_t)((delta & run_mask.delta.b) << (8 - run_shift_g))) >> (8 - run_shift_g));
+          run--;
+        }
+        else if (position < srcEnd) {
+          uint8_t op = src_[position++];
+          if ((op & SIF_OPCODE_MASK(3)) == SIF_opcode_run_delta_8b) {
+            run = op & (~SIF_OPCODE_MASK(3));
+            if (run > 0xFu) {
+              run &= 0xFu;
+              if (position < srcEnd)
+                run |= src_[position++] << 4u;
             }
-            else {
-              must_add_to_dict = true;
-              if ((op & SIF_OPCODE_MASK(1)) == SIF_opcode_delta_15b) {
-                uint16_t delta = ((op ^ SIF_opcode_delta_15b) << 8u);
-                delta |= src_[position++];
-
-                pixel.delta.r = (((int8_t)((delta >> 10u) << 3)) >> 3);
-                pixel.delta.g = (((int8_t)((delta >> 5u) << 3)) >> 3);
-                pixel.delta.b = (((int8_t)(delta << 3u)) >> 3);
-              }
-              else if ((op & SIF_OPCODE_MASK(4)) == SIF_opcode_delta_20b) {
-                uint32_t delta = (op ^ SIF_opcode_delta_20b) << 16u;
-                delta |= (src_[position++] << 8u);
-                delta |= src_[position++];
-
-                pixel.delta.r = (((int8_t)(((delta >> delta_20b_shift_r) & mask_20b.delta.r) << (delta_20b_shift_r - 12))) >> (delta_20b_shift_r - 12));
-                pixel.delta.g = (((int8_t)(((delta >> delta_20b_shift_g) & mask_20b.delta.g) << (8 + delta_20b_shift_g - delta_20b_shift_r))) >> (8 + delta_20b_shift_g - delta_20b_shift_r));
-                pixel.delta.b = (((int8_t)((delta & mask_20b.delta.b) << (8 - delta_20b_shift_g))) >> (8 - delta_20b_shift_g));
-              }
-              else { /* SIF_opcode_3chn_mask_delta_8bpc */
-                pixel.delta.r = ((op & 0x04u) > 0u) ? (int8_t)src_[position++] : 0;
-                pixel.delta.g = ((op & 0x02u) > 0u) ? (int8_t)src_[position++] : 0;
-                pixel.delta.b = ((op & 0x01u) > 0u) ? (int8_t)src_[position++] : 0;
+            run++;
+            SIF_ASSERT(run <= SIF_RUN_CACHE_SIZE);
+            cache_index = 0u;
+            while ((position < srcEnd) && (cache_index < run)) {
+              uint8_t const B = src_[position++];
+              run_cache[cache_index++] = B;
+              run0 = (B > 0u) ? 0u : run0 + 1u;
+              if ((run0 == SIF_RUN_MINIMUM_LENGTH) && (position < srcEnd)) {
+                run0 = src_[position++];
+                while ((cache_index < run) && (run0 > 0u)) {
+                  run_cache[cache_index++] = 0u;
+                  run0--;
+                }
               }
             }
+            SIF_ASSERT(cache_index == run);
+            x--;
+            cache_index = 0u;
+            run0 = 0u;
+            continue;
           }
-
-          prediction = prev_pixel;
-          switch (predictor_id) {
-            case SIF_predictor_direct:
-            default: {
-              pixel.rgba.r = prediction.rgba.r + pixel.delta.r;
-              pixel.rgba.g = prediction.rgba.g + pixel.delta.g;
-              pixel.rgba.b = prediction.rgba.b + pixel.delta.b;
-              break;
-            }
-            case SIF_predictor_decorrelate_from_red: {
-              if (use_2d_prediction && (y > 0))
-                prediction.rgba.r = (prediction.rgba.r * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.r) >> 3u;
-              int8_t const delta = pixel.delta.r;
-              pixel.rgba.r = prediction.rgba.r + delta;
-              pixel.rgba.g = prediction.rgba.g + pixel.delta.g + delta;
-              pixel.rgba.b = prediction.rgba.b + pixel.delta.b + delta;
-              break;
+          else if ((op & SIF_OPCODE_MASK(5)) == SIF_opcode_3chn_run_delta0) {
+            run0 = op ^ SIF_opcode_3chn_run_delta0;
+            pixel.value = 0;
+          }
+          else if ((op & SIF_OPCODE_MASK(2)) == SIF_opcode_reduced_offset) {
+            size_t offset = (size_t)(op ^ SIF_opcode_reduced_offset);
+            if (use_contextual_dict)
+              offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> dict_context_shift) << SIF_REDUCED_OFFSET_BIT_LENGTH;
+            pixel = dict[offset];
+            goto output_pixel;
+          }
+          else {
+            must_add_to_dict = true;
+            if ((op & SIF_OPCODE_MASK(1)) == SIF_opcode_delta_15b) {
+              uint16_t delta = ((op ^ SIF_opcode_delta_15b) << 8u);
+              delta |= src_[position++];
+
+              pixel.delta.r = (((int8_t)((delta >> 10u) << 3)) >> 3);
+              pixel.delta.g = (((int8_t)((delta >> 5u) << 3)) >> 3);
+              pixel.delta.b = (((int8_t)(delta << 3u)) >> 3);
             }
-            case SIF_predictor_decorrelate_from_green: {
-              if (use_2d_prediction && (y > 0))
-                prediction.rgba.g = (prediction.rgba.g * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.g) >> 3u;
-              int8_t const delta = pixel.delta.g;
-              pixel.rgba.g = prediction.rgba.g + delta;
-              pixel.rgba.r = prediction.rgba.r + pixel.delta.r + delta;
-              pixel.rgba.b = prediction.rgba.b + pixel.delta.b + delta;
-              break;
+            else if ((op & SIF_OPCODE_MASK(4)) == SIF_opcode_delta_20b) {
+              uint32_t delta = (op ^ SIF_opcode_delta_20b) << 16u;
+              delta |= (src_[position++] << 8u);
+              delta |= src_[position++];
+
+              pixel.delta.r = (((int8_t)(((delta >> delta_20b_shift_r) & mask_20b.delta.r) << (delta_20b_shift_r - 12))) >> (delta_20b_shift_r - 12));
+              pixel.delta.g = (((int8_t)(((delta >> delta_20b_shift_g) & mask_20b.delta.g) << (8 + delta_20b_shift_g - delta_20b_shift_r))) >> (8 + delta_20b_shift_g - delta_20b_shift_r));
+              pixel.delta.b = (((int8_t)((delta & mask_20b.delta.b) << (8 - delta_20b_shift_g))) >> (8 - delta_20b_shift_g));
             }
-            case SIF_predictor_decorrelate_from_blue: {
-              if (use_2d_prediction && (y > 0))
-                prediction.rgba.b = (prediction.rgba.b * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.b) >> 3u;
-              int8_t const delta = pixel.delta.b;
-              pixel.rgba.b = prediction.rgba.b + delta;
-              pixel.rgba.r = prediction.rgba.r + pixel.delta.r + delta;
-              pixel.rgba.g = prediction.rgba.g + pixel.delta.g + delta;
-              break;
+            else { /* SIF_opcode_3chn_mask_delta_8bpc */
+              pixel.delta.r = ((op & 0x04u) > 0u) ? (int8_t)src_[position++] : 0;
+              pixel.delta.g = ((op & 0x02u) > 0u) ? (int8_t)src_[position++] : 0;
+              pixel.delta.b = ((op & 0x01u) > 0u) ? (int8_t)src_[position++] : 0;
             }
           }
+        }
 
-          if (must_add_to_dict) {
-            size_t offset = (size_t)SIF_pixelHash(pixel);
-            if (use_contextual_dict)
-              offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> (9u - SIF_DICT_CONTEXT_BIT_LENGTH)) << SIF_REDUCED_OFFSET_BIT_LENGTH;
-            dict[offset] = pixel;
+        prediction = prev_pixel;
+        switch (predictor_id) {
+          case SIF_predictor_direct:
+          default: {
+            pixel.rgba.r = prediction.rgba.r + pixel.delta.r;
+            pixel.rgba.g = prediction.rgba.g + pixel.delta.g;
+            pixel.rgba.b = prediction.rgba.b + pixel.delta.b;
+            break;
+          }
+          case SIF_predictor_decorrelate_from_red: {
+            if (use_2d_prediction && (y > 0))
+              prediction.rgba.r = (prediction.rgba.r * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.r) >> 3u;
+            int8_t const delta = pixel.delta.r;
+            pixel.rgba.r = prediction.rgba.r + delta;
+            pixel.rgba.g = prediction.rgba.g + pixel.delta.g + delta;
+            pixel.rgba.b = prediction.rgba.b + pixel.delta.b + delta;
+            break;
+          }
+          case SIF_predictor_decorrelate_from_green: {
+            if (use_2d_prediction && (y > 0))
+              prediction.rgba.g = (prediction.rgba.g * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.g) >> 3u;
+            int8_t const delta = pixel.delta.g;
+            pixel.rgba.g = prediction.rgba.g + delta;
+            pixel.rgba.r = prediction.rgba.r + pixel.delta.r + delta;
+            pixel.rgba.b = prediction.rgba.b + pixel.delta.b + delta;
+            break;
+          }
+          case SIF_predictor_decorrelate_from_blue: {
+            if (use_2d_prediction && (y > 0))
+              prediction.rgba.b = (prediction.rgba.b * 7u + sld_wnd[(sld_offset - (x << 1u) - 1u) & SIF_SLD_WND_MASK].rgba.b) >> 3u;
+            int8_t const delta = pixel.delta.b;
+            pixel.rgba.b = prediction.rgba.b + delta;
+            pixel.rgba.r = prediction.rgba.r + pixel.delta.r + delta;
+            pixel.rgba.g = prediction.rgba.g + pixel.delta.g + delta;
+            break;
           }
-output_pixel:
-          dst_[pixel_pos + 0u] = pixel.rgba.r;
-          dst_[pixel_pos + 1u] = pixel.rgba.g;
-          dst_[pixel_pos + 2u] = pixel.rgba.b;
-          prev_pixel = pixel;
-          if (use_2d_prediction)
-            sld_wnd[sld_offset++ & SIF_SLD_WND_MASK] = pixel;
         }
+
+        if (must_add_to_dict) {
+          size_t offset = (size_t)SIF_pixelHash(pixel) & dict_set_mask;
+          if (use_contextual_dict)
+            offset |= ((prev_pixel.rgba.r + prev_pixel.rgba.g) >> dict_context_shift) << SIF_REDUCED_OFFSET_BIT_LENGTH;
+          SIF_dictInsert(&dict[offset], pixel, dict_ways);
+        }
+output_pixel:
+        dst_[pixel_pos + 0u] = pixel.rgba.r;
+        dst_[pixel_pos + 1u] = pixel.rgba.g;
+        dst_[pixel_pos + 2u] = pixel.rgba.b;
+        prev_pixel = pixel;
+        if (use_2d_prediction)
+          sld_wnd[sld_offset++ & SIF_SLD_WND_MASK] = pixel;
       }
     }
   }
-  return position;
+  decoder->prev_pixel = prev_pixel;
+  decoder->position = position;
+  decoder->cache_index = cache_index;
+  decoder->run = run;
+  decoder->run0 = run0;
+  decoder->sld_offset = sld_offset;
+  return pixels_v;
 }
 
-SIF_INLINE uint64_t SIF_compressImageBound(const SIF_content_descriptor_t* const image) {
+/* Decodes a whole slice into lines stride bytes apart and returns the size of the slice data consumed.
+   Like the encoder's, the decoder state is allocated by the caller and reused across slices. */
+size_t SIF_decompressSliceToLines(const SIF_content_descriptor_t* const slice, uint8_t const extended_flags, void* const dst, size_t const stride, const void* const src, size_t const srcSize, SIF_slice_decoder_t* const decoder) {
+  SIF_ASSERT(slice != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(decoder != NULL);
+
+  SIF_initSliceDecoder(decoder, slice, extended_flags);
+  uint8_t* const dst_ = (uint8_t*)dst;
+  for (size_t line = 0u; line < slice->height;)
+    line += SIF_decompressTileRow(decoder, &dst_[line * stride], stride, src, srcSize);
+  return decoder->position;
+}
+
+size_t SIF_decompressSlice(const SIF_content_descriptor_t* const slice, void* const dst, size_t const dstCapacity, const void* const src, size_t const srcSize) {
+  SIF_ASSERT(slice != NULL);
+  SIF_ASSERT(dstCapacity >= ((size_t)slice->width * slice->height * slice->channels));
+  (void)dstCapacity;
+  SIF_slice_decoder_t* const decoder = SIF_createDecoder();
+  size_t const size = (decoder != NULL) ? SIF_decompressSliceToLines(slice, 0u, dst, (size_t)slice->width * slice->channels, src, srcSize, decoder) : 0u;
+  SIF_freeDecoder(decoder);
+  return size;
+}
+
+static SIF_INLINE uint64_t SIF_compressImageBound(const SIF_content_descriptor_t* const image) {
   SIF_ASSERT(image != NULL);
   /* assume worst case expansion, i.e., single line per slice */
   return (uint64_t)sizeof(SIF_file_header_t) + ((uint64_t)image->height) * ((uint64_t)sizeof(SIF_slice_header_t) + ((uint64_t)image->width) * ((uint64_t)image->channels + 1u) + (uint64_t)sizeof(SIF_end_of_slice_marker_t));
 }
 
-void* SIF_compressImage(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize) {
+size_t SIF_writeFileHeader(SIF_buffer_t* const dst, const SIF_content_descriptor_t* const image, uint8_t const extended_flags) {
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(image != NULL);
+  if (!SIF_reserveBuffer(dst, (uint64_t)dst->size + sizeof(SIF_file_header_t)))
+    return 0u;
+  size_t const start = dst->size;
+  dst->data[dst->size++] = (uint8_t)(SIF_MAGIC_NUMBER >> 8u);
+  dst->data[dst->size++] = (uint8_t)(SIF_MAGIC_NUMBER | image->channels | ((extended_flags > 0u) ? SIF_MAGIC_FLAG_EXTENDED : 0u));
+  dst->size += SIF_writeULEB128(&dst->data[dst->size], image->width);
+  dst->size += SIF_writeULEB128(&dst->data[dst->size], image->height);
+  return dst->size - start;
+}
+
+/* Writes the slice header with placeholders for the size and checksum and returns the offset of the size field, or SIZE_MAX on failure. */
+size_t SIF_writeSliceHeader(SIF_buffer_t* const dst, const SIF_content_descriptor_t* const slice, uint8_t const extended_flags) {
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(slice != NULL);
+  if (!SIF_reserveBuffer(dst, (uint64_t)dst->size + sizeof(SIF_slice_header_t)))
+    return SIZE_MAX;
+  size_t const slice_size_offset = dst->size;
+  dst->size += sizeof(uint32_t);
+  dst->data[dst->size++] = slice->flags;
+  if (extended_flags > 0u)
+    dst->data[dst->size++] = extended_flags;
+  dst->size += SIF_writeULEB128(&dst->data[dst->size], slice->height);
+  if (extended_flags & SIF_EXTENDED_FLAGS_MASK_CHECKSUM)
+    dst->size += sizeof(uint32_t);
+  return slice_size_offset;
+}
+
+/* Fills in the size and checksum of the slice that was just written at the end of the buffer. */
+void SIF_completeSliceHeader(SIF_buffer_t* const dst, size_t const slice_size_offset, uint8_t const extended_flags, uint32_t const slice_size) {
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(dst->size >= slice_size_offset + slice_size);
+  *((uint32_t*)&dst->data[slice_size_offset]) = slice_size;
+  if (extended_flags & SIF_EXTENDED_FLAGS_MASK_CHECKSUM) {
+    size_t const fields = slice_size_offset + sizeof(uint32_t), checksum = dst->size - slice_size - sizeof(uint32_t);
+    *((uint32_t*)&dst->data[checksum]) = SIF_sliceChecksum(&dst->data[fields], checksum - fields, &dst->data[checksum + sizeof(uint32_t)], slice_size);
+  }
+}
+
+/* Parses the file header from the first bytes of an image and returns the position right after it,
+   or 0 if they do not start a valid SIF image. */
+size_t SIF_parseFileHeader(const void* const src, size_t const srcSize, SIF_file_header_t* const file_header, SIF_content_descriptor_t* const image) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(file_header != NULL);
+  SIF_ASSERT(image != NULL);
+  if (srcSize < SIF_PROBE_HEADER_SIZE)
+    return 0u;
+  const uint8_t* const src_ = (const uint8_t*)src;
+  size_t position = 0u;
+  file_header->magic = src_[position++] << 8u;
+  file_header->magic |= src_[position++];
+  image->channels = file_header->magic & SIF_MAGIC_MASK_CHANNELS;
+  if (((file_header->magic & 0xFFF0u) != SIF_MAGIC_NUMBER) || (image->channels != 3u))
+    return 0u;
+  file_header->width = SIF_readULEB128(src, &position, srcSize);
+  file_header->height = SIF_readULEB128(src, &position, srcSize);
+  if ((file_header->width == 0u) || (file_header->width > SIF_MAX_DIMENSION) || (file_header->height == 0u) || (file_header->height > SIF_MAX_DIMENSION))
+    return 0u;
+  image->width = file_header->width;
+  image->height = file_header->height;
+  image->flags = 0u;
+  return position;
+}
+
+/* Parses the file header and returns the position right after it, or 0 if the data is not a valid SIF image. */
+size_t SIF_readFileHeader(const void* const src, size_t const srcSize, SIF_file_header_t* const file_header, SIF_content_descriptor_t* const image) {
+  if (srcSize < SIF_MINIMUM_IMAGE_SIZE)
+    return 0u;
+  return SIF_parseFileHeader(src, srcSize, file_header, image);
+}
+
+/* Parses the fields of the slice header at *position, advancing *position to the slice data. Only
+   checks that the header itself fits in src, so src may be a window holding just the header. */
+bool SIF_parseSliceHeader(const void* const src, size_t const srcSize, size_t* const position, const SIF_file_header_t* const file_header, SIF_slice_header_t* const slice_header) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(position != NULL);
+  SIF_ASSERT(file_header != NULL);
+  SIF_ASSERT(slice_header != NULL);
+  const uint8_t* const src_ = (const uint8_t*)src;
+  bool const extended = (file_header->magic & SIF_MAGIC_FLAG_EXTENDED) > 0u;
+  if (*position + sizeof(uint32_t) + 2u * sizeof(uint8_t) + extended > srcSize)
+    return false;
+  slice_header->size = *((uint32_t*)&src_[*position]);
+  *position += sizeof(uint32_t);
+  slice_header->flags = src_[(*position)++];
+  slice_header->extended_flags = (extended) ? src_[(*position)++] : 0u;
+  slice_header->height = SIF_readULEB128(src, position, srcSize);
+  slice_header->checksum = 0u;
+  if (slice_header->extended_flags & SIF_EXTENDED_FLAGS_MASK_CHECKSUM) {
+    if (*position + sizeof(uint32_t) > srcSize)
+      return false;
+    slice_header->checksum = *((uint32_t*)&src_[*position]);
+    *position += sizeof(uint32_t);
+  }
+  return true;
+}
+
+/* Validates a parsed slice header against the size of the whole image and the lines still expected. */
+bool SIF_checkSliceHeader(const SIF_slice_header_t* const slice_header, uint64_t const data_position, uint64_t const srcSize, ULEB128_t const remaining_lines) {
+  SIF_ASSERT(slice_header != NULL);
+  return
+    ((slice_header->extended_flags & ~SIF_EXTENDED_FLAGS_MASK_KNOWN) == 0u) &&
+    (((slice_header->extended_flags & SIF_EXTENDED_FLAGS_MASK_DICT_WAYS) >> SIF_EXTENDED_FLAGS_SHIFT_DICT_WAYS) <= SIF_DICT_MAX_WAYS_EXPONENT) &&
+    (slice_header->size > sizeof(SIF_end_of_slice_marker_t)) &&
+    (slice_header->height > 0u) &&
+    (data_position + slice_header->size <= srcSize) &&
+    (slice_header->height <= remaining_lines);
+}
+
+/* Parses the slice header at *position and validates it against the lines still expected, advancing
+   *position to the slice data. If the slice has a checksum and verify is set, the header fields and
+   data are checked against it too. */
+bool SIF_readSliceHeader(const void* const src, size_t const srcSize, size_t* const position, const SIF_file_header_t* const file_header, ULEB128_t const remaining_lines, bool const verify, SIF_slice_header_t* const slice_header) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(position != NULL);
+  SIF_ASSERT(file_header != NULL);
+  SIF_ASSERT(slice_header != NULL);
+  const uint8_t* const src_ = (const uint8_t*)src;
+  bool const extended = (file_header->magic & SIF_MAGIC_FLAG_EXTENDED) > 0u;
+  size_t const fields = *position + sizeof(uint32_t);
+  if ((*position + SIF_MINIMUM_SLICE_SIZE + extended >= srcSize) || !SIF_parseSliceHeader(src, srcSize, position, file_header, slice_header))
+    return false;
+  return
+    SIF_checkSliceHeader(slice_header, *position, srcSize, remaining_lines) &&
+    (!verify || !(slice_header->extended_flags & SIF_EXTENDED_FLAGS_MASK_CHECKSUM) ||
+      (SIF_sliceChecksum(&src_[fields], *position - sizeof(uint32_t) - fields, &src_[*position], slice_header->size) == slice_header->checksum));
+}
+
+/* Starting capacity for the output: a fraction of the raw size instead of the worst case, letting
+   the slice encoder grow the buffer as needed so that peak memory tracks the compressed size. */
+static SIF_INLINE uint64_t SIF_initialOutputCapacity(const SIF_content_descriptor_t* const image) {
+  uint64_t const capacity = SIF_compressImageBound(image);
+  uint64_t const fraction = ((((uint64_t)image->width) * image->height * image->channels) >> 2u) + SIF_MINIMUM_IMAGE_SIZE;
+  return (capacity < fraction) ? capacity : fraction;
+}
+
+/* Appends the compressed image, whose lines are stride bytes apart, to the buffer. */
+bool SIF_compressImageToBuffer(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, size_t const stride, uint32_t const options, SIF_slice_encoder_t* const encoder, SIF_buffer_t* const dst) {
+  SIF_ASSERT(image != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  uint8_t const extended_flags = SIF_extendedFlags(options);
+  if (SIF_writeFileHeader(dst, image, extended_flags) == 0u)
+    return false;
+  const uint8_t* const src_ = (const uint8_t*)src;
+
+  SIF_content_descriptor_t slice = *image;
+  ULEB128_t total_height_processed = 0u;
+  size_t offset = 0u;
+  do {
+    slice.height = SIF_sliceHeight(image, image->height - total_height_processed);
+    size_t const slice_size_offset = SIF_writeSliceHeader(dst, &slice, extended_flags);
+    uint32_t const slice_size = (slice_size_offset == SIZE_MAX) ? 0u : (uint32_t)SIF_compressSliceToBuffer(&slice, dst, &src_[offset], srcSize - offset, stride, options, encoder);
+    if (slice_size == 0u)
+      break;
+    SIF_completeSliceHeader(dst, slice_size_offset, extended_flags, slice_size);
+
+    offset += slice.height * stride;
+    total_height_processed += slice.height;
+  } while (total_height_processed < image->height);
+  return total_height_processed == image->height;
+}
+
+void* SIF_compressImageEx(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize, uint32_t const options) {
   SIF_ASSERT(image != NULL);
   SIF_ASSERT((image->width > 0u) && (image->width <= SIF_MAX_DIMENSION));
   SIF_ASSERT((image->height > 0u) && (image->height <= SIF_MAX_DIMENSION));
   SIF_ASSERT(image->channels == 3u);
   SIF_ASSERT(src != NULL);
+  SIF_ASSERT(outSize != NULL);
   SIF_ASSERT(srcSize >= ((size_t)image->width * image->height * image->channels));
-  *outSize = SIF_compressImageBound(image);
-  if (*outSize > SIZE_MAX)
-    return NULL;
-  uint8_t* const dst = (uint8_t*)SIF_MALLOC((size_t)*outSize);
-  if (dst == NULL)
+  *outSize = 0u;
+  SIF_buffer_t dst = { NULL, 0u, 0u, true };
+  SIF_slice_encoder_t* const encoder = SIF_createEncoder();
+  bool const result = (encoder != NULL) && SIF_reserveBuffer(&dst, SIF_initialOutputCapacity(image)) && SIF_compressImageToBuffer(image, src, srcSize, (size_t)image->width * image->channels, options, encoder, &dst);
+  SIF_freeEncoder(encoder);
+  if (!result) {
+    SIF_FREE(dst.data);
     return NULL;
-  const uint8_t* const src_ = (const uint8_t* const)src;
-  size_t position = 0u;
-  dst[position++] = (uint8_t)(SIF_MAGIC_NUMBER >> 8u);
-  dst[position++] = (uint8_t)(SIF_MAGIC_NUMBER | image->channels);
-  position += SIF_writeULEB128(&dst[position], image->width);
-  position += SIF_writeULEB128(&dst[position], image->height);
+  }
+  *outSize = dst.size;
+  return SIF_shrinkBuffer(&dst);
+}
 
-  SIF_content_descriptor_t slice = *image;
-  ULEB128_t total_height_processed = 0u;
+/* Compresses an image whose lines are stride bytes apart into *dst, a buffer of *dstCapacity bytes
+   allocated with SIF_MALLOC (or NULL), growing it as needed. The buffer stays with the caller, who
+   can keep reusing it across images and eventually releases it with SIF_free; with an encoder from
+   SIF_createEncoder reused as well, a steady stream of images costs no allocations. Returns the
+   compressed size, or 0 if the image is invalid or the buffer could not be grown. */
+uint64_t SIF_compressImageWithEncoder(SIF_slice_encoder_t* const encoder, const SIF_content_descriptor_t* const image, const void* const src, size_t const stride, uint32_t const options, void** dst, size_t* dstCapacity) {
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(image != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(dstCapacity != NULL);
+  if ((image->width == 0u) || (image->width > SIF_MAX_DIMENSION) || (image->height == 0u) || (image->height > SIF_MAX_DIMENSION) || (image->channels != 3u))
+    return 0u;
+  uint64_t const line_size = ((uint64_t)image->width) * image->channels;
+  uint64_t const srcSize = ((uint64_t)image->height - 1u) * stride + line_size;
+  if ((stride < line_size) || (srcSize > SIZE_MAX))
+    return 0u;
+  SIF_buffer_t buffer = { (uint8_t*)*dst, 0u, (*dst != NULL) ? *dstCapacity : 0u, true };
+  bool const result = SIF_reserveBuffer(&buffer, SIF_initialOutputCapacity(image)) && SIF_compressImageToBuffer(image, src, (size_t)srcSize, stride, options, encoder, &buffer);
+  *dst = buffer.data;
+  *dstCapacity = buffer.capacity;
+  return (result) ? buffer.size : 0u;
+}
+
+uint64_t SIF_compressImageInto(const SIF_content_descriptor_t* const image, const void* const src, size_t const stride, uint32_t const options, void** dst, size_t* dstCapacity) {
+  SIF_slice_encoder_t* const encoder = SIF_createEncoder();
+  uint64_t const size = (encoder != NULL) ? SIF_compressImageWithEncoder(encoder, image, src, stride, options, dst, dstCapacity) : 0u;
+  SIF_freeEncoder(encoder);
+  return size;
+}
+
+void* SIF_compressImage(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize) {
+  return SIF_compressImageEx(image, src, srcSize, outSize, SIF_option_none);
+}
+
+/* Decodes into lines stride bytes apart, or packed lines if stride is 0, and returns the number of
+   bytes spanned by the image in dst, or 0 if the image is invalid or does not fit. */
+uint64_t SIF_decompressImageWithDecoder(SIF_slice_decoder_t* const decoder, SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, void* const dst, size_t const dstCapacity, size_t const stride) {
+  SIF_ASSERT(decoder != NULL);
+  SIF_ASSERT(image != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(dst != NULL);
+  const uint8_t* const src_ = (const uint8_t*)src;
+  uint8_t* const dst_ = (uint8_t*)dst;
+  SIF_file_header_t file_header;
+  SIF_content_descriptor_t header;
+  size_t position = SIF_readFileHeader(src, srcSize, &file_header, &header);
+  if (position == 0u)
+    return 0u;
+  uint64_t const line_size = ((uint64_t)header.width) * header.channels;
+  size_t const pitch = (stride > 0u) ? stride : (size_t)line_size;
+  uint64_t const size = ((uint64_t)header.height - 1u) * pitch + line_size;
+  if ((pitch < line_size) || (size > SIZE_MAX) || (size > (uint64_t)dstCapacity))
+    return 0u;
+
+  *image = header;
   size_t offset = 0u;
-  do {
-    slice.height = image->height - total_height_processed;
-    while (SIF_compressSliceBound(&slice) > (uint64_t)UINT32_MAX)
-      slice.height--;
+  ULEB128_t total_height_processed = 0u;
 
-    size_t const slice_size_offset = position;
-    position += sizeof(uint32_t);
-    dst[position++] = slice.flags;
-    position += SIF_writeULEB128(&dst[position], slice.height);
+  /* accepts exactly what SIF_verify does: every line decoded, each slice consuming all of its data
+     up to the end marker, and nothing left over */
+  while (total_height_processed < header.height) {
+    SIF_slice_header_t slice_header;
+    if (!SIF_readSliceHeader(src, srcSize, &position, &file_header, header.height - total_height_processed, true, &slice_header))
+      break;
 
-    uint32_t const slice_size = (uint32_t)SIF_compressSlice(&slice, &dst[position], (size_t)*outSize - position, &src_[offset], srcSize - offset);
-    position += slice_size;
-    *((uint32_t*)&dst[slice_size_offset]) = slice_size;
+    image->height = slice_header.height;
+    image->flags = slice_header.flags;
 
-    offset += slice.width * slice.height * slice.channels;
-    total_height_processed += slice.height;
-  } while (total_height_processed < image->height);
-  *outSize = position;
-  return dst;
+    size_t const data_size = slice_header.size - sizeof(SIF_end_of_slice_marker_t);
+    if (SIF_decompressSliceToLines(image, slice_header.extended_flags, &dst_[offset], pitch, &src_[position], slice_header.size, decoder) != data_size)
+      break;
+    position += data_size;
+
+    if (*((SIF_end_of_slice_marker_t*)&src_[position]) != SIF_END_OF_SLICE_MARKER)
+      break;
+    position += sizeof(SIF_end_of_slice_marker_t);
+    total_height_processed += image->height;
+    offset += image->height * pitch;
+  }
+  if ((total_height_processed != header.height) || (position != srcSize))
+    return 0u;
+  image->height = header.height;
+  return size;
+}
+
+uint64_t SIF_decompressImageIntoEx(SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, void* const dst, size_t const dstCapacity, size_t const stride) {
+  SIF_slice_decoder_t* const decoder = SIF_createDecoder();
+  uint64_t const size = (decoder != NULL) ? SIF_decompressImageWithDecoder(decoder, image, src, srcSize, dst, dstCapacity, stride) : 0u;
+  SIF_freeDecoder(decoder);
+  return size;
+}
+
+uint64_t SIF_decompressImageInto(SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, void* const dst, size_t const dstCapacity) {
+  return SIF_decompressImageIntoEx(image, src, srcSize, dst, dstCapacity, 0u);
 }
 
 void* SIF_decompressImage(SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint64_t* outSize) {
   SIF_ASSERT(image != NULL);
   SIF_ASSERT(src != NULL);
   SIF_ASSERT(outSize != NULL);
-  if (srcSize < SIF_MINIMUM_IMAGE_SIZE)
-    return NULL;
-  const uint8_t* const src_ = (const uint8_t* const)src;
   *outSize = 0u;
-  size_t position = 0u;
   SIF_file_header_t file_header;
-  file_header.magic = src_[position++] << 8u;
-  file_header.magic |= src_[position++];
-  image->channels = file_header.magic & 0x0Fu;
-  if (((file_header.magic & 0xFFF0u) != SIF_MAGIC_NUMBER) || (image->channels != 3u))
+  SIF_content_descriptor_t header;
+  if (SIF_readFileHeader(src, srcSize, &file_header, &header) == 0u)
     return NULL;
-  file_header.width = SIF_readULEB128(src, &position, srcSize);
-  file_header.height = SIF_readULEB128(src, &position, srcSize);
-  uint64_t const stride = ((uint64_t)file_header.width) * image->channels;
-  *outSize =  stride * file_header.height;
-  if ((stride > SIZE_MAX) || (*outSize > SIZE_MAX))
+  uint64_t const size = ((uint64_t)header.width) * header.channels * header.height;
+  if (size > SIZE_MAX)
     return NULL;
 
-  uint8_t* const dst = (uint8_t*)SIF_MALLOC((size_t)*outSize);
+  uint8_t* const dst = (uint8_t*)SIF_MALLOC((size_t)size);
   if (dst == NULL)
     return NULL;
-  
-  image->width = file_header.width;
-  size_t offset = 0u;
-  ULEB128_t total_height_processed = 0u;
+  *outSize = SIF_decompressImageInto(image, src, srcSize, dst, (size_t)size);
+  if (*outSize == 0u) {
+    SIF_FREE(dst);
+    return NULL;
+  }
+  return dst;
+}
+
+/* Releases memory returned by the library, for callers that cannot see SIF_FREE. */
+void SIF_free(void* const data) {
+  SIF_FREE(data);
+}
+
+void SIF_recordSlice(SIF_probe_info_t* const info, SIF_slice_info_t* const slices, size_t const maxSlices, const SIF_slice_header_t* const slice_header, uint64_t const offset) {
+  SIF_ASSERT(info != NULL);
+  SIF_ASSERT(slice_header != NULL);
+  if (info->slice_count < maxSlices) {
+    SIF_slice_info_t* const slice = &slices[info->slice_count];
+    slice->offset = offset;
+    slice->size = slice_header->size;
+    slice->height = slice_header->height;
+    slice->flags = slice_header->flags;
+    slice->extended_flags = slice_header->extended_flags;
+  }
+  info->slice_count++;
+}
 
-  while ((total_height_processed < file_header.height) && (position + SIF_MINIMUM_SLICE_SIZE < srcSize)) {
+/* Walks the slices checking their headers and end markers without decoding any pixels, recording
+   the first maxSlices of them. Returns the position after the last slice, or 0 if the image is
+   malformed or, when verify is set, a slice fails its checksum. */
+size_t SIF_walkSlices(const void* const src, size_t const srcSize, bool const verify, SIF_probe_info_t* const info, SIF_slice_info_t* const slices, size_t const maxSlices) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(info != NULL);
+  SIF_ASSERT((slices != NULL) || (maxSlices == 0u));
+  const uint8_t* const src_ = (const uint8_t*)src;
+  SIF_file_header_t file_header;
+  size_t position = SIF_readFileHeader(src, srcSize, &file_header, &info->image);
+  if (position == 0u)
+    return 0u;
+  info->extended = (file_header.magic & SIF_MAGIC_FLAG_EXTENDED) > 0u;
+  info->slice_count = 0u;
+  ULEB128_t total_height_processed = 0u;
+  while (total_height_processed < info->image.height) {
     SIF_slice_header_t slice_header;
-    slice_header.size = *((uint32_t*)&src_[position]);
-    position += sizeof(uint32_t);
-    slice_header.flags = src_[position++];
-    slice_header.height = SIF_readULEB128(src, &position, srcSize);
-
-    if (
-      (slice_header.size == 0u) ||
-      (slice_header.height == 0u) ||
-      (position + slice_header.size > srcSize) || 
-      (total_height_processed + slice_header.height > file_header.height)
-    ) {
-      SIF_FREE(dst);
-      return NULL;
+    if (!SIF_readSliceHeader(src, srcSize, &position, &file_header, info->image.height - total_height_processed, verify, &slice_header))
+      return 0u;
+    SIF_recordSlice(info, slices, maxSlices, &slice_header, position);
+    position += slice_header.size;
+    if (*((SIF_end_of_slice_marker_t*)&src_[position - sizeof(SIF_end_of_slice_marker_t)]) != SIF_END_OF_SLICE_MARKER)
+      return 0u;
+    total_height_processed += slice_header.height;
+  }
+  return position;
+}
+
+/* Checks the headers, end markers and, where present, checksums of all slices. Slices written
+   without SIF_option_slice_checksum only get the structural checks. */
+bool SIF_verify(const void* const src, size_t const srcSize) {
+  SIF_probe_info_t info;
+  size_t const end = SIF_walkSlices(src, srcSize, true, &info, NULL, 0u);
+  return (end > 0u) && (end == srcSize);
+}
+
+/* Reads only the magic number and dimensions, so src needs to hold no more than the first
+   SIF_PROBE_HEADER_SIZE bytes of the image. */
+bool SIF_probe(const void* const src, size_t const srcSize, SIF_probe_info_t* const info) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(info != NULL);
+  SIF_file_header_t file_header;
+  if (SIF_parseFileHeader(src, srcSize, &file_header, &info->image) == 0u)
+    return false;
+  info->extended = (file_header.magic & SIF_MAGIC_FLAG_EXTENDED) > 0u;
+  info->slice_count = 0u;
+  return true;
+}
+
+/* Also walks the slice headers, counting the slices and describing the first maxSlices of them in
+   slices, which may be NULL when only the count is needed. Checksums are not verified. */
+bool SIF_probeSlices(const void* const src, size_t const srcSize, SIF_probe_info_t* const info, SIF_slice_info_t* const slices, size_t const maxSlices) {
+  return SIF_walkSlices(src, srcSize, false, info, slices, maxSlices) > 0u;
+}
+
+#ifndef SIF_NO_TRANSCODERS
+
+#define SIF_QOI_MAGIC 0x716F6966u /* "qoif" */
+#define SIF_QOI_HEADER_SIZE 14u
+#define SIF_QOI_PADDING_SIZE 8u
+#define SIF_QOI_MAX_RUN 62u
+
+typedef enum {
+  SIF_qoi_op_index = 0x00, /* 00xx xxxx */
+  SIF_qoi_op_diff  = 0x40, /* 01xx xxxx */
+  SIF_qoi_op_luma  = 0x80, /* 10xx xxxx */
+  SIF_qoi_op_run   = 0xC0, /* 11xx xxxx */
+  SIF_qoi_op_rgb   = 0xFE, /* 1111 1110 */
+  SIF_qoi_op_rgba  = 0xFF  /* 1111 1111 */
+} SIF_qoi_opcodes;
+
+typedef struct {
+  SIF_pixel_t index[64];
+  SIF_pixel_t pixel;
+  uint32_t run;
+  size_t position;
+} SIF_qoi_state_t;
+
+SIF_FORCE_INLINE uint32_t SIF_qoiHash(SIF_pixel_t const pixel) {
+  return (pixel.rgba.r * 3u + pixel.rgba.g * 5u + pixel.rgba.b * 7u + pixel.rgba.a * 11u) & 63u;
+}
+
+SIF_FORCE_INLINE uint32_t SIF_readBigEndian32(const uint8_t* const src) {
+  return ((uint32_t)src[0] << 24u) | ((uint32_t)src[1] << 16u) | ((uint32_t)src[2] << 8u) | (uint32_t)src[3];
+}
+
+SIF_FORCE_INLINE void SIF_writeBigEndian32(uint8_t* const dst, uint32_t const value) {
+  dst[0] = (uint8_t)(value >> 24u);
+  dst[1] = (uint8_t)(value >> 16u);
+  dst[2] = (uint8_t)(value >> 8u);
+  dst[3] = (uint8_t)(value);
+}
+
+static SIF_INLINE void SIF_initQOIState(SIF_qoi_state_t* const state, size_t const position) {
+  SIF_ASSERT(state != NULL);
+  memset(state->index, 0, sizeof(state->index));
+  state->pixel.value = 0u;
+  state->pixel.rgba.a = 0xFFu;
+  state->run = 0u;
+  state->position = position;
+}
+
+/* Decodes the next count pixels of a QOI stream as RGB. Fails if the stream is truncated
+   or has any non-opaque pixel, since that can't be represented losslessly. */
+bool SIF_decodeQOIPixels(SIF_qoi_state_t* const state, const uint8_t* const src, size_t const chunksEnd, uint8_t* const dst, size_t const count) {
+  SIF_ASSERT(state != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_pixel_t pixel = state->pixel;
+  uint32_t run = state->run;
+  size_t position = state->position;
+  for (size_t i = 0u; i < count; i++) {
+    if (run > 0u)
+      run--;
+    else if (position < chunksEnd) {
+      /* every opcode reads at most 5 bytes, which the end padding always covers */
+      uint8_t const op = src[position++];
+      if (op == SIF_qoi_op_rgb) {
+        pixel.rgba.r = src[position++];
+        pixel.rgba.g = src[position++];
+        pixel.rgba.b = src[position++];
+      }
+      else if (op == SIF_qoi_op_rgba) {
+        pixel.rgba.r = src[position++];
+        pixel.rgba.g = src[position++];
+        pixel.rgba.b = src[position++];
+        pixel.rgba.a = src[position++];
+      }
+      else if ((op & 0xC0u) == SIF_qoi_op_index)
+        pixel = state->index[op];
+      else if ((op & 0xC0u) == SIF_qoi_op_diff) {
+        pixel.rgba.r += ((op >> 4u) & 0x03u) - 2;
+        pixel.rgba.g += ((op >> 2u) & 0x03u) - 2;
+        pixel.rgba.b += (op & 0x03u) - 2;
+      }
+      else if ((op & 0xC0u) == SIF_qoi_op_luma) {
+        uint8_t const B = src[position++];
+        int const delta_g = (op & 0x3Fu) - 32;
+        pixel.rgba.r += delta_g - 8 + ((B >> 4u) & 0x0Fu);
+        pixel.rgba.g += delta_g;
+        pixel.rgba.b += delta_g - 8 + (B & 0x0Fu);
+      }
+      else
+        run = op & 0x3Fu;
+      state->index[SIF_qoiHash(pixel)] = pixel;
     }
+    else
+      return false;
+    if (pixel.rgba.a != 0xFFu)
+      return false;
+    dst[i * 3u + 0u] = pixel.rgba.r;
+    dst[i * 3u + 1u] = pixel.rgba.g;
+    dst[i * 3u + 2u] = pixel.rgba.b;
+  }
+  state->pixel = pixel;
+  state->run = run;
+  state->position = position;
+  return true;
+}
 
-    image->height = slice_header.height;
-    image->flags = slice_header.flags;
+/* Appends count RGB pixels to a QOI stream; dst must have room for 4 bytes per pixel. */
+void SIF_encodeQOIPixels(SIF_qoi_state_t* const state, uint8_t* const dst, const uint8_t* const src, size_t const count) {
+  SIF_ASSERT(state != NULL);
+  SIF_ASSERT(dst != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_pixel_t pixel = state->pixel, prev_pixel = state->pixel;
+  uint32_t run = state->run;
+  size_t position = state->position;
+  for (size_t i = 0u; i < count; i++) {
+    pixel.rgba.r = src[i * 3u + 0u];
+    pixel.rgba.g = src[i * 3u + 1u];
+    pixel.rgba.b = src[i * 3u + 2u];
+    if (pixel.value == prev_pixel.value) {
+      if (++run == SIF_QOI_MAX_RUN) {
+        dst[position++] = (uint8_t)(SIF_qoi_op_run | (run - 1u));
+        run = 0u;
+      }
+      continue;
+    }
+    if (run > 0u) {
+      dst[position++] = (uint8_t)(SIF_qoi_op_run | (run - 1u));
+      run = 0u;
+    }
+    uint32_t const hash = SIF_qoiHash(pixel);
+    if (state->index[hash].value == pixel.value)
+      dst[position++] = (uint8_t)(SIF_qoi_op_index | hash);
+    else {
+      state->index[hash] = pixel;
+      int8_t const delta_r = pixel.rgba.r - prev_pixel.rgba.r;
+      int8_t const delta_g = pixel.rgba.g - prev_pixel.rgba.g;
+      int8_t const delta_b = pixel.rgba.b - prev_pixel.rgba.b;
+      int8_t const delta_rg = delta_r - delta_g;
+      int8_t const delta_bg = delta_b - delta_g;
+      if (SIF_checkRange(delta_r, 2) && SIF_checkRange(delta_g, 2) && SIF_checkRange(delta_b, 2))
+        dst[position++] = (uint8_t)(SIF_qoi_op_diff | ((delta_r + 2) << 4u) | ((delta_g + 2) << 2u) | (delta_b + 2));
+      else if (SIF_checkRange(delta_g, 32) && SIF_checkRange(delta_rg, 8) && SIF_checkRange(delta_bg, 8)) {
+        dst[position++] = (uint8_t)(SIF_qoi_op_luma | (delta_g + 32));
+        dst[position++] = (uint8_t)(((delta_rg + 8) << 4u) | (delta_bg + 8));
+      }
+      else {
+        dst[position++] = SIF_qoi_op_rgb;
+        dst[position++] = pixel.rgba.r;
+        dst[position++] = pixel.rgba.g;
+        dst[position++] = pixel.rgba.b;
+      }
+    }
+    prev_pixel = pixel;
+  }
+  state->pixel = prev_pixel;
+  state->run = run;
+  state->position = position;
+}
 
-    position += SIF_decompressSlice(image, &dst[offset], (size_t)*outSize - offset, &src_[position], slice_header.size);
+static SIF_INLINE bool SIF_isPPMWhitespace(uint8_t const c) {
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\v') || (c == '\f');
+}
+
+bool SIF_readPPMNumber(const uint8_t* const src, size_t const srcSize, size_t* const position, uint32_t* const value) {
+  while (*position < srcSize) {
+    if (src[*position] == '#') {
+      while ((*position < srcSize) && (src[*position] != '\n'))
+        (*position)++;
+    }
+    else if (SIF_isPPMWhitespace(src[*position]))
+      (*position)++;
+    else
+      break;
+  }
+  uint64_t r = 0u;
+  size_t const start = *position;
+  while ((*position < srcSize) && (src[*position] >= '0') && (src[*position] <= '9') && (r <= UINT32_MAX))
+    r = r * 10u + (src[(*position)++] - '0');
+  *value = (uint32_t)r;
+  return (*position > start) && (r <= UINT32_MAX);
+}
+
+/* Parses a binary 8-bit PPM header and returns the position of the pixel data, or 0 if unsupported. */
+size_t SIF_readPPMHeader(const void* const src, size_t const srcSize, SIF_content_descriptor_t* const image) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(image != NULL);
+  const uint8_t* const src_ = (const uint8_t*)src;
+  size_t position = 2u;
+  uint32_t width, height, maximum;
+  if (
+    (srcSize < 8u) || (src_[0] != 'P') || (src_[1] != '6') ||
+    !SIF_readPPMNumber(src_, srcSize, &position, &width) ||
+    !SIF_readPPMNumber(src_, srcSize, &position, &height) ||
+    !SIF_readPPMNumber(src_, srcSize, &position, &maximum) ||
+    (position >= srcSize) || !SIF_isPPMWhitespace(src_[position]) ||
+    (width == 0u) || (width > SIF_MAX_DIMENSION) || (height == 0u) || (height > SIF_MAX_DIMENSION) || (maximum != 0xFFu)
+  )
+    return 0u;
+  position++;
+  if ((uint64_t)(srcSize - position) < ((uint64_t)width) * height * 3u)
+    return 0u;
+  image->width = width;
+  image->height = height;
+  image->channels = 3u;
+  return position;
+}
+
+size_t SIF_writeDecimal(uint8_t* const dst, uint32_t value) {
+  uint8_t digits[10];
+  size_t length = 0u;
+  do {
+    digits[length++] = (uint8_t)('0' + value % 10u);
+    value /= 10u;
+  } while (value > 0u);
+  for (size_t i = 0u; i < length; i++)
+    dst[i] = digits[length - 1u - i];
+  return length;
+}
+
+bool SIF_compressQOIPixels(const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, uint32_t const options, uint8_t* const rows, SIF_slice_encoder_t* const encoder, SIF_buffer_t* const dst) {
+  SIF_ASSERT(image != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(rows != NULL);
+  SIF_ASSERT(encoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  size_t const stride = (size_t)image->width * image->channels;
+  size_t const tile_height = SIF_tileHeight(image->flags);
+  uint8_t const extended_flags = SIF_extendedFlags(options);
+  SIF_qoi_state_t qoi;
+  SIF_initQOIState(&qoi, SIF_QOI_HEADER_SIZE);
+  SIF_content_descriptor_t slice = *image;
+  for (ULEB128_t total_height_processed = 0u; total_height_processed < image->height; total_height_processed += slice.height) {
+    slice.height = SIF_sliceHeight(image, image->height - total_height_processed);
+    size_t const slice_size_offset = SIF_writeSliceHeader(dst, &slice, extended_flags);
+    if (slice_size_offset == SIZE_MAX)
+      return false;
+    SIF_initSliceEncoder(encoder, &slice, dst, options);
+    for (size_t line = 0u; line < slice.height;) {
+      size_t const lines = (slice.height - line < tile_height) ? slice.height - line : tile_height;
+      if (!SIF_decodeQOIPixels(&qoi, (const uint8_t*)src, srcSize - SIF_QOI_PADDING_SIZE, rows, lines * image->width) || (SIF_compressTileRow(encoder, dst, rows, stride) != lines))
+        return false;
+      line += lines;
+    }
+    SIF_completeSliceHeader(dst, slice_size_offset, extended_flags, (uint32_t)SIF_finishSlice(encoder, dst));
+  }
+  return true;
+}
+
+/* The QOI stream is decoded one tile row at a time straight into the SIF slice encoder, so
+   only a single tile row of RGB pixels is ever held in memory. */
+void* SIF_transcodeFromQOI(const void* const src, size_t const srcSize, uint8_t const flags, uint32_t const options, uint64_t* outSize) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(outSize != NULL);
+  *outSize = 0u;
+  const uint8_t* const src_ = (const uint8_t*)src;
+  if ((srcSize < SIF_QOI_HEADER_SIZE + SIF_QOI_PADDING_SIZE) || (SIF_readBigEndian32(src_) != SIF_QOI_MAGIC))
+    return NULL;
+  SIF_content_descriptor_t image;
+  image.width = SIF_readBigEndian32(&src_[4]);
+  image.height = SIF_readBigEndian32(&src_[8]);
+  image.channels = 3u;
+  image.flags = flags;
+  if ((image.width == 0u) || (image.width > SIF_MAX_DIMENSION) || (image.height == 0u) || (image.height > SIF_MAX_DIMENSION) || ((src_[12] != 3u) && (src_[12] != 4u)))
+    return NULL;
+  uint64_t const rows_size = ((uint64_t)image.width) * image.channels * SIF_tileHeight(flags);
+  if (rows_size > SIZE_MAX)
+    return NULL;
+  uint8_t* const rows = (uint8_t*)SIF_MALLOC((size_t)rows_size);
+  SIF_slice_encoder_t* const encoder = SIF_createEncoder();
+  SIF_buffer_t dst = { NULL, 0u, 0u, true };
+  bool const success =
+    (rows != NULL) && (encoder != NULL) &&
+    SIF_reserveBuffer(&dst, (uint64_t)srcSize + SIF_MINIMUM_IMAGE_SIZE) &&
+    (SIF_writeFileHeader(&dst, &image, SIF_extendedFlags(options)) > 0u) &&
+    SIF_compressQOIPixels(&image, src, srcSize, options, rows, encoder, &dst);
+  SIF_freeEncoder(encoder);
+  SIF_FREE(rows);
+  if (!success) {
+    SIF_FREE(dst.data);
+    return NULL;
+  }
+  *outSize = dst.size;
+  return SIF_shrinkBuffer(&dst);
+}
 
-    if ((position + sizeof(SIF_end_of_slice_marker_t) > srcSize) || (*((SIF_end_of_slice_marker_t*)&src_[position]) != SIF_END_OF_SLICE_MARKER)) {
-      SIF_FREE(dst);
-      return NULL;
+bool SIF_decompressToQOIPixels(const SIF_file_header_t* const file_header, const SIF_content_descriptor_t* const image, const void* const src, size_t const srcSize, size_t position, uint8_t* const rows, SIF_slice_decoder_t* const decoder, SIF_buffer_t* const dst) {
+  SIF_ASSERT(file_header != NULL);
+  SIF_ASSERT(image != NULL);
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(rows != NULL);
+  SIF_ASSERT(decoder != NULL);
+  SIF_ASSERT(dst != NULL);
+  const uint8_t* const src_ = (const uint8_t*)src;
+  size_t const stride = (size_t)image->width * image->channels;
+  SIF_qoi_state_t qoi;
+  SIF_initQOIState(&qoi, dst->size);
+  SIF_content_descriptor_t slice = *image;
+  for (ULEB128_t total_height_processed = 0u; total_height_processed < image->height; total_height_processed += slice.height) {
+    SIF_slice_header_t slice_header;
+    if (!SIF_readSliceHeader(src, srcSize, &position, file_header, image->height - total_height_processed, true, &slice_header))
+      return false;
+    slice.height = slice_header.height;
+    slice.flags = slice_header.flags;
+    SIF_initSliceDecoder(decoder, &slice, slice_header.extended_flags);
+    for (size_t line = 0u; line < slice.height;) {
+      size_t const lines = SIF_decompressTileRow(decoder, rows, stride, &src_[position], slice_header.size);
+      dst->size = qoi.position;
+      if (!SIF_reserveBuffer(dst, (uint64_t)dst->size + (uint64_t)lines * image->width * 4u + SIF_QOI_PADDING_SIZE))
+        return false;
+      SIF_encodeQOIPixels(&qoi, dst->data, rows, lines * image->width);
+      line += lines;
     }
+    if (decoder->position != slice_header.size - sizeof(SIF_end_of_slice_marker_t))
+      return false;
+    position += decoder->position;
+    if (*((SIF_end_of_slice_marker_t*)&src_[position]) != SIF_END_OF_SLICE_MARKER)
+      return false;
     position += sizeof(SIF_end_of_slice_marker_t);
-    total_height_processed += image->height;
-    offset += (size_t)(image->height * stride);
   }
-  image->height = file_header.height;
+  if (position != srcSize)
+    return false;
+  if (qoi.run > 0u)
+    dst->data[qoi.position++] = (uint8_t)(SIF_qoi_op_run | (qoi.run - 1u));
+  memset(&dst->data[qoi.position], 0, SIF_QOI_PADDING_SIZE - 1u);
+  dst->data[qoi.position + SIF_QOI_PADDING_SIZE - 1u] = 1u;
+  dst->size = qoi.position + SIF_QOI_PADDING_SIZE;
+  return true;
+}
+
+/* Mirror of SIF_transcodeFromQOI: each decoded tile row is immediately re-encoded as QOI. */
+void* SIF_transcodeToQOI(const void* const src, size_t const srcSize, uint64_t* outSize) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(outSize != NULL);
+  *outSize = 0u;
+  SIF_file_header_t file_header;
+  SIF_content_descriptor_t image;
+  size_t const position = SIF_readFileHeader(src, srcSize, &file_header, &image);
+  if (position == 0u)
+    return NULL;
+  /* the tile height is only known per slice, so size the rows for the tallest one */
+  uint64_t const rows_size = ((uint64_t)image.width) * image.channels * SIF_tileHeight(SIF_FLAGS_MASK_TILE_HEIGHT);
+  if (rows_size > SIZE_MAX)
+    return NULL;
+  uint8_t* const rows = (uint8_t*)SIF_MALLOC((size_t)rows_size);
+  SIF_slice_decoder_t* const decoder = SIF_createDecoder();
+  SIF_buffer_t dst = { NULL, 0u, 0u, true };
+  bool success = (rows != NULL) && (decoder != NULL) && SIF_reserveBuffer(&dst, (uint64_t)srcSize + SIF_QOI_HEADER_SIZE + SIF_QOI_PADDING_SIZE);
+  if (success) {
+    SIF_writeBigEndian32(&dst.data[0], SIF_QOI_MAGIC);
+    SIF_writeBigEndian32(&dst.data[4], image.width);
+    SIF_writeBigEndian32(&dst.data[8], image.height);
+    dst.data[12] = image.channels;
+    dst.data[13] = 0u; /* sRGB with linear alpha */
+    dst.size = SIF_QOI_HEADER_SIZE;
+    success = SIF_decompressToQOIPixels(&file_header, &image, src, srcSize, position, rows, decoder, &dst);
+  }
+  SIF_freeDecoder(decoder);
+  SIF_FREE(rows);
+  if (!success) {
+    SIF_FREE(dst.data);
+    return NULL;
+  }
+  *outSize = dst.size;
+  return SIF_shrinkBuffer(&dst);
+}
+
+/* A binary PPM already holds tightly packed RGB, so it is encoded in place without a copy. */
+void* SIF_transcodeFromPPM(const void* const src, size_t const srcSize, uint8_t const flags, uint32_t const options, uint64_t* outSize) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(outSize != NULL);
+  *outSize = 0u;
+  SIF_content_descriptor_t image;
+  size_t const position = SIF_readPPMHeader(src, srcSize, &image);
+  if (position == 0u)
+    return NULL;
+  image.flags = flags;
+  return SIF_compressImageEx(&image, &((const uint8_t*)src)[position], srcSize - position, outSize, options);
+}
+
+/* Decodes straight into the pixel area of the PPM that is returned. */
+void* SIF_transcodeToPPM(const void* const src, size_t const srcSize, uint64_t* outSize) {
+  SIF_ASSERT(src != NULL);
+  SIF_ASSERT(outSize != NULL);
+  *outSize = 0u;
+  SIF_file_header_t file_header;
+  SIF_content_descriptor_t image;
+  if (SIF_readFileHeader(src, srcSize, &file_header, &image) == 0u)
+    return NULL;
+  uint8_t header[32];
+  size_t length = 0u;
+  header[length++] = 'P';
+  header[length++] = '6';
+  header[length++] = '\n';
+  length += SIF_writeDecimal(&header[length], image.width);
+  header[length++] = ' ';
+  length += SIF_writeDecimal(&header[length], image.height);
+  header[length++] = '\n';
+  length += SIF_writeDecimal(&header[length], 0xFFu);
+  header[length++] = '\n';
+  uint64_t const size = ((uint64_t)image.width) * image.height * image.channels;
+  if (size + length > SIZE_MAX)
+    return NULL;
+  uint8_t* const dst = (uint8_t*)SIF_MALLOC((size_t)(size + length));
+  if (dst == NULL)
+    return NULL;
+  memcpy(dst, header, length);
+  if (SIF_decompressImageInto(&image, src, srcSize, &dst[length], (size_t)size) == 0u) {
+    SIF_FREE(dst);
+    return NULL;
+  }
+  *outSize = size + length;
   return dst;
 }
 
+#endif /* SIF_NO_TRANSCODERS */
+
 #ifndef SIF_NO_STDIO
 #include <stdio.h>
 
@@ -815,14 +2139,91 @@ void* SIF_read(const char* const filename, SIF_content_descriptor_t* const descr
   size_t const srcSize = ftell(input);
   fseek(input, 0, SEEK_SET);
   uint8_t* src = (uint8_t*)SIF_MALLOC(srcSize);
-  if (src == NULL)
+  if (src == NULL) {
+    fclose(input);
     return NULL;
+  }
   if (fread(src, sizeof(uint8_t), srcSize, input) != srcSize) {
+    SIF_FREE(src);
     fclose(input);
     return NULL;
   }
   fclose(input);
-  return SIF_decompressImage(descriptor, src, srcSize, outSize);
+  void* const data = SIF_decompressImage(descriptor, src, srcSize, outSize);
+  SIF_FREE(src);
+  return data;
+}
+
+/* previous end of slice marker + size + flags + extended flags + height + checksum */
+#define SIF_PROBE_SLICE_WINDOW (sizeof(SIF_end_of_slice_marker_t) + sizeof(uint32_t) + 2u * sizeof(uint8_t) + sizeof(ULEB128_t) + sizeof(uint32_t))
+
+size_t SIF_readFileRange(FILE* const input, uint64_t const offset, void* const dst, size_t const size) {
+  if (fseek(input, (long)offset, SEEK_SET) != 0)
+    return 0u;
+  return fread(dst, sizeof(uint8_t), size, input);
+}
+
+/* Probes an open file with unbuffered reads, so that only the file header and, when walking the
+   slices, a small window per slice around each slice header are read from disk. */
+bool SIF_probeStream(FILE* const input, SIF_probe_info_t* const info, bool const walk_slices, SIF_slice_info_t* const slices, size_t const maxSlices) {
+  SIF_ASSERT(input != NULL);
+  SIF_ASSERT(info != NULL);
+  SIF_ASSERT((slices != NULL) || (maxSlices == 0u));
+  setvbuf(input, NULL, _IONBF, 0);
+  uint8_t window[SIF_PROBE_SLICE_WINDOW];
+  SIF_file_header_t file_header;
+  size_t const header_size = SIF_parseFileHeader(window, SIF_readFileRange(input, 0u, window, SIF_PROBE_HEADER_SIZE), &file_header, &info->image);
+  if (header_size == 0u)
+    return false;
+  info->extended = (file_header.magic & SIF_MAGIC_FLAG_EXTENDED) > 0u;
+  info->slice_count = 0u;
+  if (!walk_slices)
+    return true;
+
+  if (fseek(input, 0, SEEK_END) != 0)
+    return false;
+  long const file_size = ftell(input);
+  if ((file_size < 0) || ((uint64_t)file_size < SIF_MINIMUM_IMAGE_SIZE))
+    return false;
+  /* each window after the first also covers the end of slice marker of the previous slice */
+  uint64_t offset = header_size;
+  size_t marker_size = 0u;
+  ULEB128_t total_height_processed = 0u;
+  while (total_height_processed < info->image.height) {
+    uint64_t const start = offset - marker_size;
+    size_t const size = SIF_readFileRange(input, start, window, sizeof(window));
+    if ((size < marker_size) || ((marker_size > 0u) && (*((SIF_end_of_slice_marker_t*)window) != SIF_END_OF_SLICE_MARKER)))
+      return false;
+    size_t position = marker_size;
+    SIF_slice_header_t slice_header;
+    if (!SIF_parseSliceHeader(window, size, &position, &file_header, &slice_header) || !SIF_checkSliceHeader(&slice_header, start + position, (uint64_t)file_size, info->image.height - total_height_processed))
+      return false;
+    SIF_recordSlice(info, slices, maxSlices, &slice_header, start + position);
+    offset = start + position + slice_header.size;
+    marker_size = sizeof(SIF_end_of_slice_marker_t);
+    total_height_processed += slice_header.height;
+  }
+  return (SIF_readFileRange(input, offset - marker_size, window, marker_size) == marker_size) && (*((SIF_end_of_slice_marker_t*)window) == SIF_END_OF_SLICE_MARKER);
+}
+
+bool SIF_probeFile(const char* const filename, SIF_probe_info_t* const info) {
+  SIF_ASSERT(filename != NULL);
+  FILE* input = fopen(filename, "rb");
+  if (!input)
+    return false;
+  bool const result = SIF_probeStream(input, info, false, NULL, 0u);
+  fclose(input);
+  return result;
+}
+
+bool SIF_probeFileSlices(const char* const filename, SIF_probe_info_t* const info, SIF_slice_info_t* const slices, size_t const maxSlices) {
+  SIF_ASSERT(filename != NULL);
+  FILE* input = fopen(filename, "rb");
+  if (!input)
+    return false;
+  bool const result = SIF_probeStream(input, info, true, slices, maxSlices);
+  fclose(input);
+  return result;
 }
 
 #endif /* SIF_NO_STDIO */
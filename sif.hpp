@@ -0,0 +1,314 @@
+/*
+SIF - Simple Image Format, C++17 interface
+
+Copyright (c) 2022 Marcio Pais
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+A thin wrapper over the C API in sif.h: the implementation still comes from defining
+SIF_IMPLEMENTATION in exactly one translation unit before including either header.
+
+Memory returned by the library is owned by sif::Buffer and images are passed as views of caller
+memory with an explicit pitch. A sif::Encoder or sif::Decoder keeps the codec state from call to
+call, so encoding or decoding a stream of images with the same object needs no allocations once
+the buffers have grown and no copies beyond the codec's own output. Failures are reported by
+return values, as in the C API.
+*/
+
+#ifndef SIF_HPP
+#define SIF_HPP
+
+#include "sif.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator> /* std::data, std::size */
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sif {
+
+struct RGB8 {
+  uint8_t r, g, b;
+};
+
+/* Maps a pixel type onto the codec's 3 interleaved 8-bit channels: a pixel is elements_per_pixel
+   consecutive values of the type. Specialize it to use other tightly packed 3-byte types. */
+template <typename T>
+struct PixelTraits;
+
+template <>
+struct PixelTraits<RGB8> {
+  static constexpr size_t elements_per_pixel = 1u;
+};
+
+template <>
+struct PixelTraits<std::array<uint8_t, 3u>> {
+  static constexpr size_t elements_per_pixel = 1u;
+};
+
+template <>
+struct PixelTraits<uint8_t> {
+  static constexpr size_t elements_per_pixel = 3u;
+};
+
+template <typename T>
+constexpr bool is_pixel_v = (sizeof(T) * PixelTraits<std::remove_const_t<T>>::elements_per_pixel == 3u) && std::is_trivially_copyable_v<T>;
+
+/* Read-only view of contiguous bytes; any container with byte-sized elements converts to it. */
+class ByteView {
+public:
+  ByteView() noexcept = default;
+  ByteView(const void* const data, size_t const size) noexcept : data_(static_cast<const uint8_t*>(data)), size_(size) {}
+  template <typename Container, typename = std::enable_if_t<sizeof(*std::data(std::declval<const Container&>())) == 1u>>
+  ByteView(const Container& container) noexcept : ByteView(std::data(container), std::size(container)) {}
+
+  const uint8_t* data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0u; }
+  const uint8_t* begin() const noexcept { return data_; }
+  const uint8_t* end() const noexcept { return data_ + size_; }
+
+private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0u;
+};
+
+/* Lines of width pixels, pitch bytes apart, so that sub-rectangles and padded rows need no copy. */
+template <typename Pixel>
+struct ImageView {
+  static_assert(is_pixel_v<Pixel>, "pixels must be 3 bytes of interleaved 8-bit channels, see sif::PixelTraits");
+
+  Pixel* data = nullptr;
+  uint32_t width = 0u;
+  uint32_t height = 0u;
+  size_t pitch = 0u;
+
+  ImageView() noexcept = default;
+  ImageView(Pixel* const data, uint32_t const width, uint32_t const height, size_t const pitch = 0u) noexcept :
+    data(data), width(width), height(height), pitch((pitch > 0u) ? pitch : (size_t)width * 3u) {}
+  template <typename Other, typename = std::enable_if_t<std::is_convertible_v<Other*, Pixel*>>>
+  ImageView(const ImageView<Other>& other) noexcept : data(other.data), width(other.width), height(other.height), pitch(other.pitch) {}
+
+  /* bytes spanned from the first pixel to the end of the last line */
+  size_t extent() const noexcept { return (height > 0u) ? (height - 1u) * pitch + (size_t)width * 3u : 0u; }
+};
+
+/* Owns memory allocated by the library and releases it with SIF_free. Move-only. */
+class Buffer {
+public:
+  Buffer() noexcept = default;
+  Buffer(Buffer&& other) noexcept :
+    data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0u)), capacity_(std::exchange(other.capacity_, 0u)) {}
+  Buffer& operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+      SIF_free(data_);
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0u);
+      capacity_ = std::exchange(other.capacity_, 0u);
+    }
+    return *this;
+  }
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+  ~Buffer() { SIF_free(data_); }
+
+  /* Takes over memory returned by the C functions, e.g. SIF_compressImageEx or SIF_read. */
+  static Buffer adopt(void* const data, size_t const size) noexcept {
+    Buffer buffer;
+    buffer.data_ = static_cast<uint8_t*>(data);
+    buffer.size_ = buffer.capacity_ = (data != nullptr) ? size : 0u;
+    return buffer;
+  }
+
+  uint8_t* data() noexcept { return data_; }
+  const uint8_t* data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+  size_t capacity() const noexcept { return capacity_; }
+  bool empty() const noexcept { return size_ == 0u; }
+  const uint8_t* begin() const noexcept { return data_; }
+  const uint8_t* end() const noexcept { return data_ + size_; }
+  operator ByteView() const noexcept { return ByteView(data_, size_); }
+
+  /* Empties the buffer but keeps its memory for reuse. */
+  void clear() noexcept { size_ = 0u; }
+
+  /* Gives up ownership; the memory must then be released with SIF_free. */
+  uint8_t* release() noexcept {
+    size_ = capacity_ = 0u;
+    return std::exchange(data_, nullptr);
+  }
+
+private:
+  friend class Encoder;
+
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0u;
+  size_t capacity_ = 0u;
+};
+
+/* Owns the encoder state, created on first use, and an output buffer. Move-only. */
+class Encoder {
+public:
+  explicit Encoder(uint8_t const flags = 0u, uint32_t const options = SIF_option_none) noexcept : flags_(flags), options_(options) {}
+  Encoder(Encoder&& other) noexcept :
+    flags_(other.flags_), options_(other.options_), state_(std::exchange(other.state_, nullptr)), buffer_(std::move(other.buffer_)) {}
+  Encoder& operator=(Encoder&& other) noexcept {
+    if (this != &other) {
+      SIF_freeEncoder(state_);
+      flags_ = other.flags_;
+      options_ = other.options_;
+      state_ = std::exchange(other.state_, nullptr);
+      buffer_ = std::move(other.buffer_);
+    }
+    return *this;
+  }
+  Encoder(const Encoder&) = delete;
+  Encoder& operator=(const Encoder&) = delete;
+  ~Encoder() { SIF_freeEncoder(state_); }
+
+  uint8_t flags() const noexcept { return flags_; }
+  void setFlags(uint8_t const flags) noexcept { flags_ = flags; }
+  uint32_t options() const noexcept { return options_; }
+  void setOptions(uint32_t const options) noexcept { options_ = options; }
+
+  /* Compresses into out, reusing and growing its memory. On failure, i.e. an invalid image or
+     running out of memory, returns false and leaves out empty. */
+  template <typename Pixel>
+  bool encode(const ImageView<Pixel>& image, Buffer& out) noexcept {
+    SIF_content_descriptor_t const descriptor = { image.width, image.height, 3u, flags_ };
+    void* data = out.data_;
+    size_t capacity = out.capacity_;
+    uint64_t const size = ((image.data != nullptr) && reserveState()) ? SIF_compressImageWithEncoder(state_, &descriptor, image.data, image.pitch, options_, &data, &capacity) : 0u;
+    out.data_ = static_cast<uint8_t*>(data);
+    out.capacity_ = capacity;
+    out.size_ = (size_t)size;
+    return size > 0u;
+  }
+
+  /* Compresses into the encoder's own buffer, which is reused from call to call; the view stays
+     valid until the next call or release(). Returns an empty view on failure. */
+  template <typename Pixel>
+  ByteView encode(const ImageView<Pixel>& image) noexcept {
+    return encode(image, buffer_) ? ByteView(buffer_) : ByteView();
+  }
+
+  /* Hands over the result of the last encode(image). */
+  Buffer release() noexcept { return std::move(buffer_); }
+
+private:
+  bool reserveState() noexcept {
+    if (state_ == nullptr)
+      state_ = SIF_createEncoder();
+    return state_ != nullptr;
+  }
+
+  uint8_t flags_;
+  uint32_t options_;
+  SIF_slice_encoder_t* state_ = nullptr;
+  Buffer buffer_;
+};
+
+/* Owns the decoder state, created on first use, and storage for decode(src). Move-only. */
+class Decoder {
+public:
+  Decoder() noexcept = default;
+  Decoder(Decoder&& other) noexcept : state_(std::exchange(other.state_, nullptr)), pixels_(std::move(other.pixels_)) {}
+  Decoder& operator=(Decoder&& other) noexcept {
+    if (this != &other) {
+      SIF_freeDecoder(state_);
+      state_ = std::exchange(other.state_, nullptr);
+      pixels_ = std::move(other.pixels_);
+    }
+    return *this;
+  }
+  Decoder(const Decoder&) = delete;
+  Decoder& operator=(const Decoder&) = delete;
+  ~Decoder() { SIF_freeDecoder(state_); }
+
+  /* Reads the dimensions from the first SIF_PROBE_HEADER_SIZE bytes only. */
+  static bool probe(ByteView const src, SIF_probe_info_t& info) noexcept {
+    return (src.data() != nullptr) && SIF_probe(src.data(), src.size(), &info);
+  }
+
+  static bool verify(ByteView const src) noexcept {
+    return (src.data() != nullptr) && SIF_verify(src.data(), src.size());
+  }
+
+  /* Decodes into caller memory, whose dimensions must match the image's. */
+  template <typename Pixel>
+  bool decodeInto(ByteView const src, const ImageView<Pixel>& dst) noexcept {
+    static_assert(!std::is_const_v<Pixel>, "cannot decode into a read-only view");
+    SIF_probe_info_t info;
+    if ((dst.data == nullptr) || !probe(src, info) || (info.image.width != dst.width) || (info.image.height != dst.height))
+      return false;
+    SIF_content_descriptor_t image;
+    return reserveState() && (SIF_decompressImageWithDecoder(state_, &image, src.data(), src.size(), dst.data, dst.extent(), dst.pitch) > 0u);
+  }
+
+  /* Resizes a contiguous container of pixels, e.g. std::vector<sif::RGB8> or std::vector<uint8_t>,
+     to the image and decodes straight into it. Only the resize may throw. */
+  template <typename Container>
+  bool decode(ByteView const src, Container& pixels, SIF_content_descriptor_t* const image = nullptr) {
+    using Pixel = typename Container::value_type;
+    static_assert(is_pixel_v<Pixel>, "pixels must be 3 bytes of interleaved 8-bit channels, see sif::PixelTraits");
+    SIF_probe_info_t info;
+    if (!probe(src, info) || !reserveState())
+      return false;
+    pixels.resize((size_t)info.image.width * info.image.height * PixelTraits<Pixel>::elements_per_pixel);
+    SIF_content_descriptor_t descriptor;
+    if (SIF_decompressImageWithDecoder(state_, &descriptor, src.data(), src.size(), std::data(pixels), std::size(pixels) * sizeof(Pixel), 0u) == 0u)
+      return false;
+    if (image != nullptr)
+      *image = descriptor;
+    return true;
+  }
+
+  /* Decodes into the decoder's own storage, which only grows, so that decoding a stream of images
+     allocates nothing once it has reached the largest size; the view stays valid until the next
+     call. Returns an empty view on failure. */
+  ImageView<const RGB8> decode(ByteView const src) {
+    SIF_probe_info_t info;
+    if (!probe(src, info))
+      return ImageView<const RGB8>();
+    size_t const count = (size_t)info.image.width * info.image.height;
+    if (pixels_.size() < count)
+      pixels_.resize(count);
+    ImageView<RGB8> const view(pixels_.data(), info.image.width, info.image.height);
+    return decodeInto(src, view) ? view : ImageView<const RGB8>();
+  }
+
+private:
+  bool reserveState() noexcept {
+    if (state_ == nullptr)
+      state_ = SIF_createDecoder();
+    return state_ != nullptr;
+  }
+
+  SIF_slice_decoder_t* state_ = nullptr;
+  std::vector<RGB8> pixels_;
+};
+
+} /* namespace sif */
+
+#endif /* SIF_HPP */